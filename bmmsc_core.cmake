@@ -0,0 +1,25 @@
+# sources of the bmmsc_core library, shared by the firmware (CMakeLists.txt)
+# and the host build (host/CMakeLists.txt)
+
+set(BMMSC_CORE_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+# portable: builds for the pico and against the host shims
+set(BMMSC_CORE_SOURCES
+    ${BMMSC_CORE_DIR}/camera.cc
+    ${BMMSC_CORE_DIR}/http_client.cc
+    ${BMMSC_CORE_DIR}/json.c
+    ${BMMSC_CORE_DIR}/serial.c
+    ${BMMSC_CORE_DIR}/dhcpserver/dhcpserver.c
+    ${BMMSC_CORE_DIR}/flash_store.c
+    ${BMMSC_CORE_DIR}/heap_guard.c
+    ${BMMSC_CORE_DIR}/telemetry.c
+    ${BMMSC_CORE_DIR}/trace.c
+)
+
+# pico only, the host build replaces these with host_network.c / host_pico.c
+set(BMMSC_CORE_DEVICE_SOURCES
+    ${BMMSC_CORE_DIR}/uart_console.c
+    ${BMMSC_CORE_DIR}/usb_console.c
+    ${BMMSC_CORE_DIR}/usb_network.c
+    ${BMMSC_CORE_DIR}/usb_descriptors.c
+)
@@ -1,18 +1,17 @@
 #pragma once
 #include "pico/stdlib.h"
-
-#include <map>
-#include <algorithm>
+#include "trace.h"
 
 class Button;
 
+// inline: the front-ends and the core library may all include this header
 namespace ButtonPriv {
-    std::map<int, Button*> buttons;
-    bool initialized = false;
+    inline Button* buttons[NUM_BANK0_GPIOS] = {nullptr};
+    inline bool initialized = false;
 
     void buttonPrivGpioCallback(uint gpio, uint32_t events);
 
-    void registerButton(int pin, Button* button) {
+    inline void registerButton(int pin, Button* button) {
         buttons[pin] = button;
 
         if (!initialized) {
@@ -32,6 +31,7 @@ public:
     bool eventPressed;
     bool eventReleased;
     bool eventLongPressed;
+    bool cancelled; // part of a chord, no short / long press for this one
     
 
     uint64_t lastInterruptTime;
@@ -47,6 +47,7 @@ public:
         eventPressed = false;
         eventReleased = false;
         eventLongPressed = false;
+        cancelled = false;
 
         lastInterruptTime = 0;
         lastUpTime = 0;
@@ -98,6 +99,11 @@ public:
             eventReleased = false;
             stableDown = false;
 
+            if (cancelled) {
+                cancelled = false;
+                return false;
+            }
+
             wasShort = true;
             if ((now - startDownTime) > LONG_PRESS) {
                 wasShort = false;
@@ -114,9 +120,22 @@ public:
         return released(wasShort) && wasShort;
     }
 
+    // down and not yet used up by a chord
+    bool held() const {
+        return stableDown && !cancelled;
+    }
+
+    // this press was part of a chord: swallow its long press and release
+    void cancel() {
+        cancelled = true;
+        eventLongPressed = false;
+    }
+
     void gpio_callback(uint gpio, uint32_t events) {
         uint64_t now = time_us_64() / 1000;
 
+        TRACE(TRACE_CAT_BUTTON, TRACE_EV_BUTTON_EDGE, gpio, events);
+
         if (events & GPIO_IRQ_EDGE_FALL) {
             lastDownTime = now;
             eventReleased = false;
@@ -139,11 +158,9 @@ public:
 };
 
 namespace ButtonPriv {
-    void buttonPrivGpioCallback(uint gpio, uint32_t events) {
-        auto it = buttons.find(gpio);
-
-        if (it != buttons.end()) {
-            ((Button*)(it->second))->gpio_callback(gpio, events);
+    inline void buttonPrivGpioCallback(uint gpio, uint32_t events) {
+        if (gpio < NUM_BANK0_GPIOS && buttons[gpio] != nullptr) {
+            buttons[gpio]->gpio_callback(gpio, events);
         }
     }
 };
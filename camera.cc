@@ -0,0 +1,727 @@
+extern "C" {
+#include <stdio.h>
+#include <string.h>
+
+#include "json.h"
+#include "trace.h"
+#include "usb_network.h"
+}
+
+#include "camera.h"
+
+// presets until some are saved: tungsten at native high gain, daylight at
+// native low gain. no nd, the micro studio camera doesn't have one
+static const Camera::Preset DEFAULT_PRESETS[] = {
+    {"indoor", 1 << CameraState::WB | 1 << CameraState::GAIN, {18, 3200, 0, 0, 0, 0, 0}},
+    {"outdoor", 1 << CameraState::WB | 1 << CameraState::GAIN, {0, 5600, 0, 0, 0, 0, 0}},
+};
+
+static_assert(sizeof(Camera::Preset) * Camera::NUM_PRESETS <= FLASH_STORE_MAX_DATA, "presets must fit one flash record");
+
+Camera::Camera() {
+    wbIndex = 0;
+
+    memset(presets, 0, sizeof(presets));
+    memcpy(presets, DEFAULT_PRESETS, sizeof(DEFAULT_PRESETS));
+    presetIndex = -1;
+
+    state.setDefault(CameraState::GAIN, 0);
+    state.setDefault(CameraState::WB, 3000);
+    state.setDefault(CameraState::SHUTTER, 180);
+
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        lastWriteId[p] = -1;
+    }
+
+    httpClient.onComplete = requestComplete;
+    httpClient.onCompleteCtx = this;
+
+    memset(&saved, 0, sizeof(saved));
+}
+
+
+// the README's use case first: clean feed off around the change, so it
+// doesn't need three presses
+const Camera::Macro Camera::macros[NUM_MACROS] = {
+    {"gain", 3, {{SET_CLEANFEED, 0}, {SET_GAIN, TOGGLE}, {SET_CLEANFEED, 1}}},
+    {"take", 3, {{SET_WB, 5600}, {SET_GAIN, 0}, {DO_RECORD, 1}}},
+};
+
+/* actions ====================================== */
+
+// optimistic update plus the PUT that makes it true. without a request
+// nothing would ever confirm the value: it fails right away
+bool Camera::write(CameraState::Property prop, int value, int action, const char* path, const char* body) {
+    HttpRequest* req = httpClient.newPutRequest(action, path, body, value);
+    if (req == nullptr) {
+        writeFailed(prop, action);
+        return false;
+    }
+
+    lastWriteId[prop] = req->id;
+    state.set(prop, value, CameraState::OPTIMISTIC);
+    return true;
+}
+
+// no request for the write: shown as failed, like a rejected one
+void Camera::writeFailed(CameraState::Property prop, int action) {
+    state.rollback(prop);
+    printf("camera: %s not sent (no free request), %s stays %d\n", actionNames[action],
+        CameraState::propertyNames[prop], state.get(prop));
+}
+
+bool Camera::doAutoFocus() {
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, DO_FOCUS, 0);
+    return httpClient.newPutRequest(DO_FOCUS, "lens/focus/doAutoFocus", "") != nullptr;
+}
+
+void Camera::toggleRecord() {
+    if (state.get(CameraState::RECORD) == 0) {
+        startRecord();
+    } else {
+        stopRecord();
+    }
+}
+
+void Camera::startRecord() {
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, DO_RECORD, 1);
+    write(CameraState::RECORD, 1, DO_RECORD, "transports/0/record", "{\"recording\": true}");
+}
+
+void Camera::stopRecord() {
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, DO_STOP, 0);
+    write(CameraState::RECORD, 0, DO_STOP, "transports/0/stop", "");
+}
+
+void Camera::setGain(int newGain) {
+    char arg[32];
+    snprintf(arg, sizeof(arg), "{\"gain\": %d}", newGain);
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_GAIN, newGain);
+    write(CameraState::GAIN, newGain, SET_GAIN, "video/gain", arg);
+}
+
+void Camera::toggleNativeGain() {
+    setGain(state.get(CameraState::GAIN) == 0 ? 18 : 0);
+}
+
+void Camera::setWB(int kelvin) {
+    char arg[32];
+    snprintf(arg, sizeof(arg), "{\"whiteBalance\": %d}", kelvin);
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_WB, kelvin);
+    write(CameraState::WB, kelvin, SET_WB, "video/whiteBalance", arg);
+}
+
+void Camera::cycleWB() {
+    wbIndex ++;
+    if (wbIndex >= NUM_WB_VALUES) {
+        wbIndex = 0;
+    }
+
+    setWB(wbValues[wbIndex]);
+}
+
+// the camera picks the value, read it back once it's done
+void Camera::autoWB() {
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_WB, 0);
+    HttpRequest* req = httpClient.newPutRequest(SET_WB, "video/whiteBalance/doAuto", "", UNDEF);
+    if (req == nullptr) {
+        writeFailed(CameraState::WB, SET_WB);
+        return;
+    }
+    lastWriteId[CameraState::WB] = req->id;
+}
+
+void Camera::setCleanFeed(bool enabled) {
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_CLEANFEED, enabled);
+    write(CameraState::CLEANFEED, enabled, SET_CLEANFEED, "monitoring/display/cleanFeed",
+        enabled ? "{\"enabled\": true}" : "{\"enabled\": false}");
+}
+
+void Camera::setShutter(int speed) {
+    char arg[32];
+    snprintf(arg, sizeof(arg), "{\"shutterSpeed\": %d}", speed);
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_SHUTTER, speed);
+    write(CameraState::SHUTTER, speed, SET_SHUTTER, "video/shutter", arg);
+}
+
+void Camera::setIris(int tenths) {
+    char arg[32];
+    snprintf(arg, sizeof(arg), "{\"apertureStop\": %d.%d}", tenths / 10, tenths % 10);
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_APERTURE, tenths);
+    write(CameraState::IRIS, tenths, SET_APERTURE, "lens/iris", arg);
+}
+
+void Camera::setND(int tenths) {
+    char arg[32];
+    snprintf(arg, sizeof(arg), "{\"stop\": %d.%d}", tenths / 10, tenths % 10);
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_ACTION, SET_ND, tenths);
+    write(CameraState::ND, tenths, SET_ND, "video/ndFilter", arg);
+}
+
+void Camera::setProperty(CameraState::Property prop, int value) {
+    switch (prop) {
+    case CameraState::GAIN:
+        setGain(value);
+        break;
+    case CameraState::WB:
+        setWB(value);
+        break;
+    case CameraState::SHUTTER:
+        setShutter(value);
+        break;
+    case CameraState::IRIS:
+        setIris(value);
+        break;
+    case CameraState::ND:
+        setND(value);
+        break;
+    case CameraState::CLEANFEED:
+        setCleanFeed(value != 0);
+        break;
+    default:
+        // recording is never part of a preset
+        break;
+    }
+}
+
+void Camera::sendDebugRequest(const char* message) {
+    char path[64];
+    snprintf(path, sizeof(path), "debug/%s", message);
+    httpClient.newPutRequest(SET_DEBUG, path, "");
+}
+
+/* macros ======================================= */
+
+void Camera::runMacro(const Macro& m) {
+    macro = &m;
+    macroFirstId = httpClient.cnter;
+    macroAcked = 0;
+    macroFailed = 0;
+    macroStartTs = time_us_64();
+    macroDoneTs = 0;
+
+    uint32_t queued = httpClient.stats.requests;
+    httpClient.beginPipeline();
+    for (int i = 0; i < m.numSteps; i++) {
+        runStep(m.steps[i]);
+    }
+    httpClient.sendPipeline();
+    macroEndId = httpClient.cnter;
+
+    // steps that didn't get a request (pool full) count as failed
+    macroFailed = m.numSteps - (int)(httpClient.stats.requests - queued);
+    if (macroFailed == m.numSteps) {
+        macroDoneTs = time_us_64();
+        printMacro();
+    }
+}
+
+void Camera::runStep(const MacroStep& step) {
+    switch (step.action) {
+    case SET_GAIN:
+        if (step.value == TOGGLE) {
+            toggleNativeGain();
+        } else {
+            setGain(step.value);
+        }
+        break;
+
+    case SET_WB:
+        setWB(step.value);
+        break;
+
+    case SET_CLEANFEED:
+        setCleanFeed(step.value == TOGGLE ? !state.get(CameraState::CLEANFEED) : step.value != 0);
+        break;
+
+    case DO_RECORD:
+        startRecord();
+        break;
+
+    case DO_STOP:
+        stopRecord();
+        break;
+
+    case DO_FOCUS:
+        doAutoFocus();
+        break;
+
+    default:
+        printf("camera: %s can't be a macro step\n", actionNames[step.action]);
+        macroFailed++;
+        break;
+    }
+}
+
+void Camera::macroStepDone(HttpRequest* req) {
+    if (req->ok()) {
+        macroAcked++;
+    } else {
+        macroFailed++;
+    }
+    if (macroAcked + macroFailed < macro->numSteps) {
+        return;
+    }
+
+    macroDoneTs = time_us_64();
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_MACRO, macroAcked, (uint32_t)(macroDoneTs - macroStartTs));
+    printMacro();
+}
+
+const Camera::Macro* Camera::findMacro(const char* name) {
+    for (const Macro& m : macros) {
+        if (strcmp(m.name, name) == 0) {
+            return &m;
+        }
+    }
+    return nullptr;
+}
+
+void Camera::printMacro() const {
+    if (macro == nullptr) {
+        printf("camera: no macro run yet\n");
+    } else if (macroDoneTs == 0) {
+        printf("camera: macro %s running, %d/%d steps answered\n", macro->name, macroAcked + macroFailed,
+            macro->numSteps);
+    } else {
+        printf("camera: macro %s, %d/%d steps acknowledged in %llu us\n", macro->name, macroAcked, macro->numSteps,
+            (unsigned long long)(macroDoneTs - macroStartTs));
+    }
+}
+
+/* presets ====================================== */
+
+int Camera::recallPreset(int slot) {
+    if (slot < 0 || slot >= NUM_PRESETS || presets[slot].mask == 0) {
+        return 0;
+    }
+    presetIndex = slot;
+
+    // no ordering between the properties, each write gets its own
+    // connection and they all go out in this loop iteration
+    const Preset& preset = presets[slot];
+    int writes = 0;
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        CameraState::Property prop = (CameraState::Property)p;
+        if (!(preset.mask & 1 << p)) {
+            continue;
+        }
+        // the sync found the camera doesn't have it, the write would only fail
+        if ((probed & ~supported) & 1 << p) {
+            continue;
+        }
+        // already there, or on its way there
+        if (state.known(prop) && state.get(prop) == preset.values[p]) {
+            continue;
+        }
+        setProperty(prop, preset.values[p]);
+        writes++;
+    }
+
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_PRESET, slot, writes);
+    printf("camera: preset %s, %d writes\n", preset.name, writes);
+    return writes;
+}
+
+void Camera::nextPreset() {
+    for (int i = 1; i <= NUM_PRESETS; i++) {
+        int slot = (presetIndex + i + NUM_PRESETS) % NUM_PRESETS;
+        if (presets[slot].mask != 0) {
+            recallPreset(slot);
+            return;
+        }
+    }
+}
+
+bool Camera::savePreset(int slot, const char* name) {
+    if (slot < 0 || slot >= NUM_PRESETS) {
+        return false;
+    }
+
+    Preset& preset = presets[slot];
+    memset(&preset, 0, sizeof(preset));
+    strncpy(preset.name, name, sizeof(preset.name) - 1);
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        if (p != CameraState::RECORD && state.known((CameraState::Property)p)) {
+            preset.mask |= 1 << p;
+            preset.values[p] = state.get((CameraState::Property)p);
+        }
+    }
+
+    // saved by hand and rarely, straight to flash
+    return flash_store_write(FLASH_STORE_PRESETS, presets, sizeof(presets));
+}
+
+void Camera::printPresets() const {
+    for (int slot = 0; slot < NUM_PRESETS; slot++) {
+        const Preset& preset = presets[slot];
+        if (preset.mask == 0) {
+            printf("  %d -\n", slot);
+            continue;
+        }
+        printf("  %d %-11s", slot, preset.name);
+        for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+            if (preset.mask & 1 << p) {
+                printf(" %s=%ld", CameraState::propertyNames[p], (long)preset.values[p]);
+            }
+        }
+        printf("%s\n", slot == presetIndex ? "  (last recalled)" : "");
+    }
+}
+
+/* startup sync ================================= */
+
+void Camera::linkUp(const dhcp_server_lease_event_t* ev) {
+    linkUpTs = time_us_64();
+    readyTs = 0;
+    httpClient.setTarget(&ev->ip, ev->hostname);
+
+    // a different camera: what we know about the last one doesn't apply
+    if (memcmp(ev->mac, saved.mac, sizeof(saved.mac)) != 0) {
+        probed = 0;
+        supported = 0;
+    }
+    memcpy(saved.mac, ev->mac, sizeof(saved.mac));
+    for (int i = 0; i < 4; i++) {
+        saved.ip[i] = ip4_addr_get_byte(ip_2_ip4(&ev->ip), i);
+    }
+    strncpy(saved.hostname, ev->hostname, sizeof(saved.hostname) - 1);
+    // the lease goes to flash on the next loop, it's what makes the next boot
+    // fast. not from here: this runs inside lwIP's input processing, and a
+    // flash write stops interrupts and may erase a sector
+    leaseDirty = true;
+    saveDueTs = time_us_64();
+
+    startSync();
+}
+
+// first good answer since the lease, the end of the startup path
+void Camera::ready() {
+    readyTs = time_us_64();
+    uint64_t usbUpTs = usb_network_up_us();
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_READY, 0, (uint32_t)(usbUpTs != 0 ? readyTs - usbUpTs : 0));
+    printStartup();
+}
+
+void Camera::printStartup() const {
+    uint64_t usbUpTs = usb_network_up_us();
+    if (usbUpTs == 0 || linkUpTs < usbUpTs) {
+        printf("camera: no lease since usb enumeration\n");
+        return;
+    }
+    printf("camera: usb up at %llu ms, lease +%llu ms", (unsigned long long)(usbUpTs / 1000),
+        (unsigned long long)((linkUpTs - usbUpTs) / 1000));
+    if (readyTs != 0) {
+        printf(", first answer +%llu ms", (unsigned long long)((readyTs - usbUpTs) / 1000));
+    }
+    printf("\n");
+}
+
+void Camera::startSync() {
+    // answers to an earlier sync still in flight don't count for this one
+    syncGeneration++;
+    syncStartTs = time_us_64();
+    syncDoneTs = 0;
+    syncInFlight = 0;
+    syncFailed = 0;
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        // one try for what this camera didn't answer last time
+        bool unsupported = (probed & ~supported) & 1 << p;
+        syncAttempts[p] = unsupported ? SYNC_ATTEMPTS - 1 : 0;
+        syncQueued[p] = true;
+    }
+
+    printf("camera: reading %d properties\n", CameraState::NUM_PROPERTIES);
+    pumpSync();
+}
+
+// keep up to SYNC_PARALLEL GETs in flight, note the time once all are answered
+void Camera::pumpSync() {
+    if (!syncing()) {
+        return;
+    }
+
+    bool queued = false;
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        if (!syncQueued[p]) {
+            continue;
+        }
+        if (syncInFlight >= SYNC_PARALLEL) {
+            queued = true;
+            break;
+        }
+
+        const PropertyInfo& info = propertyInfo[p];
+        if (!httpClient.newGetRequest(info.getAction, info.path, syncGeneration)) {
+            // pool is full, next loop
+            queued = true;
+            break;
+        }
+        syncQueued[p] = false;
+        syncAttempts[p]++;
+        syncInFlight++;
+    }
+
+    if (queued || syncInFlight > 0) {
+        return;
+    }
+
+    syncDoneTs = time_us_64();
+    uint32_t us = (uint32_t)(syncDoneTs - syncStartTs);
+    TRACE(TRACE_CAT_APP, TRACE_EV_APP_SYNC, CameraState::NUM_PROPERTIES - syncFailed, us);
+    printSync();
+}
+
+void Camera::syncAnswered(HttpRequest* req, CameraState::Property prop) {
+    syncInFlight--;
+
+    if (req->ok()) {
+        probed |= 1 << prop;
+        supported |= 1 << prop;
+        return;
+    }
+    // usually the camera still configuring its address, try again
+    if (syncAttempts[prop] < SYNC_ATTEMPTS) {
+        syncQueued[prop] = true;
+    } else {
+        syncFailed++;
+        probed |= 1 << prop;
+        supported &= ~(1 << prop);
+    }
+}
+
+void Camera::printSync() const {
+    if (syncStartTs == 0) {
+        printf("camera: not synced yet\n");
+    } else if (syncDoneTs == 0) {
+        printf("camera: sync running for %llu ms\n", (unsigned long long)((time_us_64() - syncStartTs) / 1000));
+    } else {
+        printf("camera: synced %d/%d properties in %llu ms after link up\n", CameraState::NUM_PROPERTIES - syncFailed,
+            CameraState::NUM_PROPERTIES, (unsigned long long)((syncDoneTs - syncStartTs) / 1000));
+    }
+    printStartup();
+}
+
+// a camera with a fixed address never asks for a lease: find it by name.
+// the cache asks the network once per ttl, a new address starts a sync
+void Camera::resolve() {
+    uint64_t usbUpTs = usb_network_up_us();
+    if (linkUpTs != 0 || usbUpTs == 0 || time_us_64() - usbUpTs < NO_LEASE_MS * 1000ull) {
+        return;
+    }
+
+    ip_addr_t ip;
+    if (!mdns.lookup(httpClient.hostHeader(), &ip)) {
+        return;
+    }
+    if (resolved && ip_addr_cmp(&ip, &resolvedIp)) {
+        return;
+    }
+
+    resolved = true;
+    ip_addr_copy(resolvedIp, ip);
+    httpClient.setTarget(&ip);
+    startSync();
+}
+
+/* flash ======================================== */
+
+bool Camera::restore(dhcp_server_t* dhcp) {
+    if (flash_store_read(FLASH_STORE_PRESETS, presets, sizeof(presets))) {
+        for (Preset& preset : presets) {
+            preset.name[sizeof(preset.name) - 1] = 0;
+        }
+    }
+
+    if (!flash_store_read(FLASH_STORE_CAMERA, &saved, sizeof(saved))) {
+        memset(&saved, 0, sizeof(saved));
+        return false;
+    }
+    saved.hostname[sizeof(saved.hostname) - 1] = 0;
+    probed = saved.probed;
+    supported = saved.supported;
+
+    int slot = saved.ip[3] - DHCPS_BASE_IP;
+    if (slot >= 0 && slot < DHCPS_MAX_IP) {
+        dhcp_server_preload(dhcp, slot, saved.mac);
+    }
+    ip_addr_t ip;
+    IP_ADDR4(&ip, saved.ip[0], saved.ip[1], saved.ip[2], saved.ip[3]);
+    httpClient.setTarget(&ip, saved.hostname);
+
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        if (saved.known & 1 << p) {
+            state.set((CameraState::Property)p, saved.values[p], CameraState::STORED);
+        }
+    }
+
+    printf("camera: last seen %02x:%02x:%02x:%02x:%02x:%02x %s at %u.%u.%u.%u\n", saved.mac[0], saved.mac[1], saved.mac[2],
+        saved.mac[3], saved.mac[4], saved.mac[5], saved.hostname, saved.ip[0], saved.ip[1], saved.ip[2], saved.ip[3]);
+    return true;
+}
+
+// the record as it would be written now: what the camera last confirmed
+void Camera::build(Stored& rec) const {
+    memcpy(&rec, &saved, sizeof(rec));
+    rec.probed = probed;
+    rec.supported = supported;
+    rec.known = 0;
+    for (int p = 0; p < CameraState::NUM_PROPERTIES; p++) {
+        const CameraState::Entry& e = state.entry((CameraState::Property)p);
+        rec.values[p] = 0;
+        if (p != CameraState::RECORD && e.goodSource != CameraState::UNKNOWN) {
+            rec.known |= 1 << p;
+            rec.values[p] = e.goodValue;
+        }
+    }
+}
+
+// write SAVE_DELAY_MS after the settings settled, never during a sync. a
+// new lease doesn't wait for either
+void Camera::save() {
+    if (syncing() && !leaseDirty) {
+        return;
+    }
+
+    Stored rec;
+    build(rec);
+    if (!leaseDirty && memcmp(&rec, &saved, sizeof(rec)) == 0) {
+        saveDueTs = 0;
+        return;
+    }
+
+    uint64_t now = time_us_64();
+    if (saveDueTs == 0) {
+        saveDueTs = now + SAVE_DELAY_MS * 1000ull;
+        return;
+    }
+    if (now < saveDueTs) {
+        return;
+    }
+
+    memcpy(&saved, &rec, sizeof(saved));
+    saveDueTs = 0;
+    leaseDirty = false;
+    flash_store_write(FLASH_STORE_CAMERA, &saved, sizeof(saved));
+}
+
+/* responses ==================================== */
+
+bool Camera::update() {
+    httpClient.updateQueue();
+    resolve();
+    pumpSync();
+    save();
+
+    bool changed = state.version() != lastVersion || state.statusVersion() != lastStatusVersion;
+    lastVersion = state.version();
+    lastStatusVersion = state.statusVersion();
+    return changed;
+}
+
+// answer to a GET. a write in flight for the same property wins, its ack
+// decides what the camera ends up with
+void Camera::readBack(CameraState::Property prop, int value) {
+    if (value == UNDEF) {
+        return;
+    }
+    if (state.entry(prop).pending()) {
+        state.setGood(prop, value, CameraState::CONFIRMED);
+        return;
+    }
+    state.set(prop, value, CameraState::CONFIRMED);
+}
+
+void Camera::requestComplete(HttpRequest* req, void* ctx) {
+    Camera* camera = (Camera*)ctx;
+
+    // an answer from the address before the last setTarget() says nothing
+    // about the camera now
+    if (req->ok() && camera->linkUpTs != 0 && camera->readyTs == 0 &&
+        ip_addr_cmp(&req->remote, &HttpClient::target)) {
+        camera->ready();
+    }
+
+    if (camera->macro != nullptr && camera->macroDoneTs == 0 && req->id >= camera->macroFirstId &&
+        req->id < camera->macroEndId) {
+        camera->macroStepDone(req);
+    }
+
+    CameraState::Property prop;
+    switch (req->action) {
+    case DO_RECORD:
+    case DO_STOP:
+        prop = CameraState::RECORD;
+        break;
+
+    case SET_GAIN:
+        prop = CameraState::GAIN;
+        break;
+
+    case SET_WB:
+        prop = CameraState::WB;
+        break;
+
+    case SET_CLEANFEED:
+        prop = CameraState::CLEANFEED;
+        break;
+
+    case SET_APERTURE:
+        prop = CameraState::IRIS;
+        break;
+
+    case SET_SHUTTER:
+        prop = CameraState::SHUTTER;
+        break;
+
+    case SET_ND:
+        prop = CameraState::ND;
+        break;
+
+    default:
+        // reads
+        for (const PropertyInfo& info : propertyInfo) {
+            if (info.getAction == req->action) {
+                if (req->ok()) {
+                    int value = info.scale == 0 ? get_json_bool(req->body(), info.key)
+                        : info.scale == 1 ? get_json_value(req->body(), info.key)
+                        : get_json_fixed(req->body(), info.key, info.scale);
+                    TRACE(TRACE_CAT_APP, TRACE_EV_APP_STATE, req->action, value);
+                    camera->readBack(info.prop, value == UNDEF_BOOL && info.scale == 0 ? UNDEF : value);
+                }
+                if (req->value != 0 && req->value == camera->syncGeneration) {
+                    camera->syncAnswered(req, info.prop);
+                }
+            }
+        }
+        return;
+    }
+
+    // a newer write to the same property is in flight, its ack decides
+    if (req->id != camera->lastWriteId[prop]) {
+        if (req->ok() && req->value != UNDEF) {
+            camera->state.setGood(prop, req->value, CameraState::CONFIRMED);
+        }
+        return;
+    }
+
+    if (!req->ok()) {
+        camera->state.rollback(prop);
+        printf("camera: %s failed (err %d, status %d), %s back to %d\n", actionNames[req->action], req->error,
+            req->statusCode, CameraState::propertyNames[prop], camera->state.get(prop));
+        return;
+    }
+
+    if (req->value == UNDEF) {
+        // auto white balance: the ack doesn't say what the camera picked
+        camera->httpClient.newGetRequest(GET_WB, "video/whiteBalance");
+        return;
+    }
+
+    camera->state.set(prop, req->value, CameraState::CONFIRMED);
+}
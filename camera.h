@@ -0,0 +1,271 @@
+#pragma once
+#include "camera_state.h"
+#include "http_client.h"
+
+#include "mdns_cache.h"
+
+#include "dhcpserver/dhcpserver.h"
+#include "flash_store.h"
+
+/**
+ * the actions that change the camera and the bookkeeping around them. every
+ * change is written to state as OPTIMISTIC, so the display shows it at once,
+ * and goes out as a PUT. the acknowledgement marks it CONFIRMED, a failure or
+ * error status rolls it back - unless a newer write to the same property is
+ * already on its way, then that one decides. answers to GETs land in state
+ * the same way. shared by both firmwares.
+ */
+class Camera {
+public:
+    enum ActionType {
+        DO_RECORD,
+        DO_STOP,
+        DO_FOCUS,
+        SET_CLEANFEED,
+        SET_APERTURE,
+        GET_APERTURE,
+        SET_GAIN,
+        GET_GAIN,
+        SET_WB,
+        GET_WB,
+        GET_SHUTTER,
+        GET_ND,
+        GET_RECORD,
+        GET_CLEANFEED,
+        SET_SHUTTER,
+        SET_ND,
+        SET_DEBUG
+    };
+
+    static constexpr int NUM_ACTION_TYPES = SET_DEBUG + 1;
+    static constexpr const char* actionNames[NUM_ACTION_TYPES] = {
+        "DO_RECORD", "DO_STOP", "DO_FOCUS", "SET_CLEANFEED", "SET_APERTURE", "GET_APERTURE",
+        "SET_GAIN", "GET_GAIN", "SET_WB", "GET_WB", "GET_SHUTTER", "GET_ND", "GET_RECORD",
+        "GET_CLEANFEED", "SET_SHUTTER", "SET_ND", "SET_DEBUG"
+    };
+
+    // where each property lives in the api and how its json value maps to
+    // the int in CameraState (scale 10: f-stops and nd stops in tenths, 0: bool)
+    struct PropertyInfo {
+        CameraState::Property prop;
+        int getAction;
+        const char* path;
+        const char* key;
+        int scale;
+    };
+
+    static constexpr PropertyInfo propertyInfo[CameraState::NUM_PROPERTIES] = {
+        {CameraState::GAIN, GET_GAIN, "video/gain", "gain", 1},
+        {CameraState::WB, GET_WB, "video/whiteBalance", "whiteBalance", 1},
+        {CameraState::SHUTTER, GET_SHUTTER, "video/shutter", "shutterSpeed", 1},
+        {CameraState::IRIS, GET_APERTURE, "lens/iris", "apertureStop", 10},
+        {CameraState::ND, GET_ND, "video/ndFilter", "stop", 10},
+        {CameraState::RECORD, GET_RECORD, "transports/0/record", "recording", 0},
+        {CameraState::CLEANFEED, GET_CLEANFEED, "monitoring/display/cleanFeed", "enabled", 0},
+    };
+
+    // startup sync: GETs in flight at once, and attempts per property
+    static const int SYNC_PARALLEL = 3;
+    static const int SYNC_ATTEMPTS = 3;
+
+    static constexpr int GAIN_MIN = -12;
+    static constexpr int GAIN_MAX = 36;
+    static constexpr int WB_MIN = 1800;
+    static constexpr int WB_MAX = 9900;
+
+    // what the flash store keeps about the camera between power cycles
+    // (FLASH_STORE_CAMERA). recording isn't kept, the tally would light up
+    // on the next boot
+    struct Stored {
+        uint8_t mac[6];
+        uint8_t ip[4]; // its lease
+        char hostname[DHCPS_HOSTNAME_LEN + 1];
+        uint8_t probed;    // bit per property: a sync asked for it...
+        uint8_t supported; // ...and the camera answered
+        uint8_t known;     // bit per property with a value below
+        int32_t values[CameraState::NUM_PROPERTIES];
+    };
+
+    // settings are written this long after the last change, not per press
+    static const uint32_t SAVE_DELAY_MS = 5000;
+
+    // no lease this long after usb came up: the camera may have a fixed
+    // address, look its name up with mdns
+    static const uint32_t NO_LEASE_MS = 3000;
+
+    // a step of a macro: one of the SET_ / DO_ actions and the value its
+    // setter takes. TOGGLE flips gain between native 0 / 18 and clean feed
+    // on / off, like the buttons do
+    struct MacroStep {
+        int action;
+        int value;
+    };
+
+    static const int MAX_MACRO_STEPS = 6;
+    static constexpr int TOGGLE = -20000; // outside every property's range
+
+    struct Macro {
+        const char* name;
+        int numSteps;
+        MacroStep steps[MAX_MACRO_STEPS];
+    };
+
+    // built in, bound to button gestures and runnable from the console
+    static constexpr int NUM_MACROS = 2;
+    static const Macro macros[NUM_MACROS];
+
+    // a look to switch to in one press: values (iris and nd in tenths of a
+    // stop) for the properties in mask. kept in flash (FLASH_STORE_PRESETS)
+    struct Preset {
+        char name[12];
+        uint8_t mask; // bit per CameraState::Property
+        int32_t values[CameraState::NUM_PROPERTIES];
+    };
+
+    static const int NUM_PRESETS = 4;
+
+    static constexpr int NUM_WB_VALUES = 5;
+    static constexpr int wbValues[NUM_WB_VALUES] = {2800, 4000, 5200, 6000, 7000};
+
+    HttpClient httpClient;
+    CameraState state;
+    MdnsCache mdns;
+
+    // position in wbValues for cycleWB()
+    int wbIndex;
+
+    Preset presets[NUM_PRESETS];
+    // the preset recalled last, for nextPreset(). -1 before the first
+    int presetIndex;
+
+    Camera();
+
+    // false if the pool had no request for it
+    bool doAutoFocus();
+    void toggleRecord();
+    void startRecord();
+    void stopRecord();
+
+    void setGain(int newGain);
+    void toggleNativeGain();
+
+    void setWB(int kelvin);
+    void cycleWB();
+    void autoWB();
+
+    void setCleanFeed(bool enabled);
+
+    // shutter speed as 1/x s, iris and nd in tenths of a stop
+    void setShutter(int speed);
+    void setIris(int tenths);
+    void setND(int tenths);
+
+    // write every setting of the preset the camera isn't at already, all at
+    // once on their own connections, so a recall takes about one round
+    // trip. returns the number of writes sent
+    int recallPreset(int slot);
+    // the next used slot after the last recalled one
+    void nextPreset();
+    // the current settings (all but recording) into slot, written to flash
+    bool savePreset(int slot, const char* name);
+    void printPresets() const;
+
+    // all steps go out pipelined on one connection and the camera applies
+    // them in order, so a macro takes about one round trip. every step is
+    // confirmed or rolled back on its own, like a single press
+    void runMacro(const Macro& macro);
+    static const Macro* findMacro(const char* name);
+    void printMacro() const;
+
+    void sendDebugRequest(const char* message);
+
+    // the camera got (or renewed) its address: send requests there and
+    // read its state again, it may have been power cycled
+    void linkUp(const dhcp_server_lease_event_t* ev);
+
+    // last session's camera from the flash store: its lease is reserved in
+    // dhcp again, requests go to its address and the display shows its
+    // settings until the sync replaces them. false if nothing was stored.
+    // the saved presets are read here too
+    bool restore(dhcp_server_t* dhcp);
+
+    // read every property from the camera, SYNC_PARALLEL at a time. update()
+    // drives it
+    void startSync();
+    bool syncing() const {
+        return syncStartTs != 0 && syncDoneTs == 0;
+    }
+    void printSync() const;
+
+    // usb enumeration -> camera lease -> first answer, the boot-to-ready time
+    void printStartup() const;
+
+    // run the http queue and apply finished requests. true if a value or a
+    // pending / failed marker changed since the last call, i.e. a display
+    // needs a redraw
+    bool update();
+
+private:
+    // id of the latest write per property, older acks don't overwrite it
+    int lastWriteId[CameraState::NUM_PROPERTIES];
+    uint32_t lastVersion = 0;
+    uint32_t lastStatusVersion = 0;
+
+    // lease and first good answer after it, for printStartup()
+    uint64_t linkUpTs = 0;
+    uint64_t readyTs = 0;
+    void ready();
+
+    // the record last written to (or read from) flash, and since when the
+    // current one differs from it
+    Stored saved;
+    uint64_t saveDueTs = 0;
+    // a new lease is in saved but not in flash yet, save() writes it next loop
+    bool leaseDirty = false;
+    // capabilities: properties a sync asked for / got an answer to
+    uint8_t probed = 0;
+    uint8_t supported = 0;
+    void build(Stored& rec) const;
+    void save();
+
+    // address the camera's name resolved to, if it was looked up
+    bool resolved = false;
+    ip_addr_t resolvedIp;
+    void resolve();
+
+    // startup sync progress. its GETs carry the generation in
+    // HttpRequest::value, other GETs have 0
+    int syncGeneration = 0;
+    uint64_t syncStartTs = 0;
+    uint64_t syncDoneTs = 0;
+    int syncInFlight = 0;
+    int syncFailed = 0;
+    int syncAttempts[CameraState::NUM_PROPERTIES];
+    bool syncQueued[CameraState::NUM_PROPERTIES]; // failed, ask again
+
+    void pumpSync();
+    void syncAnswered(HttpRequest* req, CameraState::Property prop);
+
+    // the macro run last and how its steps were answered. its requests are
+    // the ids [macroFirstId, macroEndId)
+    const Macro* macro = nullptr;
+    int macroFirstId = 0;
+    int macroEndId = 0;
+    int macroAcked = 0;
+    int macroFailed = 0;
+    uint64_t macroStartTs = 0;
+    uint64_t macroDoneTs = 0;
+    void runStep(const MacroStep& step);
+    void macroStepDone(HttpRequest* req);
+
+    void readBack(CameraState::Property prop, int value);
+
+    // the setter for prop
+    void setProperty(CameraState::Property prop, int value);
+
+    // false if the pool had no request for it, the property is rolled back
+    bool write(CameraState::Property prop, int value, int action, const char* path, const char* body);
+    void writeFailed(CameraState::Property prop, int action);
+
+    static void requestComplete(HttpRequest* req, void* ctx);
+};
@@ -0,0 +1,296 @@
+#pragma once
+#include "camera.h"
+#include "console.h"
+
+extern "C" {
+#include <stdlib.h>
+
+#include "json.h"
+#include "trace.h"
+#include "usb_network.h"
+}
+
+/**
+ * console commands for the camera: actions, http counters and histograms,
+ * runtime parameters and micro benchmarks. shared by both firmwares.
+ */
+namespace CameraCommands {
+    Camera* camera = nullptr;
+
+    bool record(int, char**, void*) {
+        camera->toggleRecord();
+        printf("record %d\n", camera->state.get(CameraState::RECORD));
+        return true;
+    }
+
+    bool focus(int, char**, void*) {
+        camera->doAutoFocus();
+        return true;
+    }
+
+    bool gain(int argc, char** argv, void*) {
+        if (argc == 1) {
+            printf("gain %d\n", camera->state.get(CameraState::GAIN));
+        } else if (strcmp(argv[1], "native") == 0) {
+            camera->toggleNativeGain();
+        } else {
+            camera->setGain(atoi(argv[1]));
+        }
+        return true;
+    }
+
+    bool wb(int argc, char** argv, void*) {
+        if (argc == 1) {
+            printf("wb %d\n", camera->state.get(CameraState::WB));
+        } else if (strcmp(argv[1], "cycle") == 0) {
+            camera->cycleWB();
+        } else if (strcmp(argv[1], "auto") == 0) {
+            camera->autoWB();
+        } else {
+            int kelvin = atoi(argv[1]);
+            if (kelvin < Camera::WB_MIN || kelvin > Camera::WB_MAX) {
+                printf("white balance out of range (%d..%d)\n", Camera::WB_MIN, Camera::WB_MAX);
+                return false;
+            }
+            camera->setWB(kelvin);
+        }
+        return true;
+    }
+
+    bool state(int argc, char** argv, void*) {
+        if (argc == 2 && strcmp(argv[1], "sync") == 0) {
+            camera->startSync();
+            return true;
+        }
+        if (argc != 1) {
+            printf("usage: state [sync]\n");
+            return false;
+        }
+        camera->state.print();
+        camera->printSync();
+        return true;
+    }
+
+    bool macro(int argc, char** argv, void*) {
+        if (argc == 1) {
+            for (const Camera::Macro& m : Camera::macros) {
+                printf("  %-8s", m.name);
+                for (int i = 0; i < m.numSteps; i++) {
+                    const Camera::MacroStep& step = m.steps[i];
+                    if (step.value == Camera::TOGGLE) {
+                        printf(" %s toggle", Camera::actionNames[step.action]);
+                    } else {
+                        printf(" %s %d", Camera::actionNames[step.action], step.value);
+                    }
+                }
+                printf("\n");
+            }
+            camera->printMacro();
+            return true;
+        }
+
+        const Camera::Macro* m = Camera::findMacro(argv[1]);
+        if (m == nullptr) {
+            printf("no macro %s\n", argv[1]);
+            return false;
+        }
+        camera->runMacro(*m);
+        return true;
+    }
+
+    bool preset(int argc, char** argv, void*) {
+        if (argc == 1) {
+            camera->printPresets();
+            return true;
+        }
+        if (argc == 2) {
+            if (camera->recallPreset(atoi(argv[1])) == 0) {
+                printf("nothing to change\n");
+            }
+            return true;
+        }
+        if (argc == 4 && strcmp(argv[1], "save") == 0) {
+            if (!camera->savePreset(atoi(argv[2]), argv[3])) {
+                printf("usage: preset save <0..%d> <name>\n", Camera::NUM_PRESETS - 1);
+                return false;
+            }
+            return true;
+        }
+        printf("usage: preset [<slot> | save <slot> <name>]\n");
+        return false;
+    }
+
+    bool mdns(int argc, char** argv, void*) {
+        if (argc == 2) {
+            // look a name up, the answer shows on the next "mdns"
+            ip_addr_t ip;
+            camera->mdns.lookup(argv[1], &ip);
+        }
+        camera->mdns.print();
+        return true;
+    }
+
+    bool debug(int argc, char** argv, void*) {
+        if (argc != 2) {
+            printf("usage: debug <message>\n");
+            return false;
+        }
+        camera->sendDebugRequest(argv[1]);
+        return true;
+    }
+
+    bool stats(int argc, char** argv, void*) {
+        if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+            HttpClient::stats.reset();
+            return true;
+        }
+        HttpClient::stats.printCounters();
+        printf("http: active=%u done=%u\n", (unsigned)camera->httpClient.activeRequests.size(),
+            (unsigned)camera->httpClient.doneRequests.size());
+        printf("http: request pool in use=%u high water=%u/%u full=%lu\n", (unsigned)HttpClient::requestPool.inUse,
+            (unsigned)HttpClient::requestPool.highWater, (unsigned)HttpClient::requestPool.capacity(),
+            (unsigned long)HttpClient::requestPool.failures);
+        return true;
+    }
+
+    bool hist(int, char**, void*) {
+        HttpClient::stats.printHistograms(Camera::actionNames, Camera::NUM_ACTION_TYPES);
+        return true;
+    }
+
+    struct Param {
+        const char* name;
+        int* value;
+    };
+
+    Param params[] = {
+        {"http.timeout_ms", &HttpClient::requestTimeoutMs},
+        {"http.retries", &HttpClient::maxRetries},
+        {"http.prewarm_ms", &HttpClient::prewarmMaxAgeMs},
+        {"http.close_mode", &HttpClient::closeMode},
+    };
+
+    bool set(int argc, char** argv, void*) {
+        for (Param& param : params) {
+            if (argc == 1) {
+                printf("  %s = %d\n", param.name, *param.value);
+            } else if (argc == 3 && strcmp(argv[1], param.name) == 0) {
+                *param.value = atoi(argv[2]);
+                return true;
+            }
+        }
+
+        if (argc != 1) {
+            printf("usage: set [<name> <value>]\n");
+            return false;
+        }
+        return true;
+    }
+
+    // fire n autofocus requests, as many at once as there are connections:
+    // the pool holds only MAX_REQUESTS. a request that gets no slot fails
+    bool benchHttp(int n) {
+        uint64_t t0 = time_us_64();
+        int firstId = camera->httpClient.cnter;
+        camera->httpClient.keepDone = true;
+
+        int sent = 0;
+        int completed = 0;
+        int failed = 0;
+        uint64_t sumUs = 0;
+        while (completed + failed < n && time_us_64() - t0 < 10 * 1000000ull) {
+            while (sent < n && sent - completed - failed < HttpClient::MAX_CONNECTIONS) {
+                sent++;
+                if (!camera->doAutoFocus()) {
+                    failed++;
+                }
+            }
+
+            usb_network_update();
+            camera->update();
+
+            for (HttpRequest* req : camera->httpClient.doneRequests) {
+                if (req->id < firstId) {
+                    continue;
+                }
+                if (req->error == ERR_OK) {
+                    completed++;
+                    sumUs += req->completeTs - req->startTs;
+                } else {
+                    failed++;
+                }
+                camera->httpClient.release(req);
+            }
+            camera->httpClient.doneRequests.clear();
+        }
+        uint64_t elapsed = time_us_64() - t0;
+        camera->httpClient.keepDone = false;
+
+        printf("bench http: %d requests, %d ok, %d failed in %llu us, %.1f req/s, avg %llu us\n", n, completed, failed,
+            (unsigned long long)elapsed, elapsed ? completed * 1e6 / elapsed : 0.0,
+            (unsigned long long)(completed ? sumUs / completed : 0));
+        return failed == 0 && completed == n;
+    }
+
+    bool bench(int argc, char** argv, void*) {
+        if (argc < 2) {
+            printf("usage: bench json|trace|format|http [n]\n");
+            return false;
+        }
+
+        const char* name = argv[1];
+        int n = argc > 2 ? atoi(argv[2]) : 1000;
+        if (n <= 0) {
+            return false;
+        }
+
+        if (strcmp(name, "http") == 0) {
+            return benchHttp(n);
+        }
+
+        static const char* body = "{\"gain\": 18, \"whiteBalance\": 5600, \"recording\": false}";
+        char buff[256];
+        volatile int sink = 0;
+
+        uint64_t t0 = time_us_64();
+        if (strcmp(name, "json") == 0) {
+            for (int i = 0; i < n; i++) {
+                sink += get_json_value(body, "whiteBalance");
+            }
+        } else if (strcmp(name, "trace") == 0) {
+            for (int i = 0; i < n; i++) {
+                trace_event(TRACE_EV_APP_STATE, 0, i);
+            }
+        } else if (strcmp(name, "format") == 0) {
+            for (int i = 0; i < n; i++) {
+                sink += snprintf(buff, sizeof(buff), "PUT /control/api/v1/%s HTTP/1.1\r\nContent-Length: %d\r\n", "video/gain", i);
+            }
+        } else {
+            printf("unknown benchmark '%s'\n", name);
+            return false;
+        }
+        uint64_t elapsed = time_us_64() - t0;
+
+        printf("bench %s: %d iterations in %llu us, %llu ns each\n", name, n, (unsigned long long)elapsed,
+            (unsigned long long)(elapsed * 1000 / n));
+        return true;
+    }
+
+    void add(Console& console, Camera& _camera) {
+        camera = &_camera;
+
+        console.add("record", "toggle recording", record, nullptr);
+        console.add("focus", "trigger autofocus", focus, nullptr);
+        console.add("gain", "[native|<db>] show or set gain", gain, nullptr);
+        console.add("wb", "[cycle|auto|<kelvin>] show or set white balance", wb, nullptr);
+        console.add("state", "[sync] cached camera properties, sync reads them all again", state, nullptr);
+        console.add("macro", "[<name>] list macros and the last run, or run one", macro, nullptr);
+        console.add("preset", "[<slot> | save <slot> <name>] list, recall or save presets", preset, nullptr);
+        console.add("mdns", "[<name>.local] mdns cache, look a name up", mdns, nullptr);
+        console.add("debug", "<message> send a debug request", debug, nullptr);
+        console.add("stats", "[reset] http counters", stats, nullptr);
+        console.add("hist", "http latency histograms per action", hist, nullptr);
+        console.add("set", "[<name> <value>] show or change parameters", set, nullptr);
+        console.add("bench", "json|trace|format|http [n] micro benchmarks", bench, nullptr);
+    }
+};
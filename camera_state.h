@@ -0,0 +1,190 @@
+#pragma once
+#include "pico/stdlib.h"
+#include "trace.h"
+
+#include <stdio.h>
+
+/**
+ * what the controller knows about each camera property: the value, where it
+ * came from, when and a version that moves only when the value changes.
+ *
+ *   OPTIMISTIC - we asked the camera for it, no answer yet
+ *   CONFIRMED  - the camera acknowledged the write or answered a GET
+ *   PUSHED     - the camera reported it on its own (event stream)
+ *   STORED     - last session's value from flash, until the camera answers
+ *
+ * listeners (display, tally light) are called on value changes only, a
+ * confirmation of the value we already show is silent. the global version()
+ * lets a front-end redraw once per loop instead of once per change.
+ *
+ * an optimistic value is shown right away as pending. if the camera rejects
+ * the write, rollback() puts back the last value it confirmed and flags the
+ * entry as failed until the next good update. statusVersion() moves on those
+ * pending / failed transitions, so a display can redraw its markers.
+ */
+class CameraState {
+public:
+    enum Property {
+        GAIN,
+        WB,
+        SHUTTER,
+        IRIS,
+        ND,
+        RECORD,
+        CLEANFEED,
+        NUM_PROPERTIES
+    };
+
+    static constexpr const char* propertyNames[NUM_PROPERTIES] = {
+        "gain", "wb", "shutter", "iris", "nd", "record", "cleanfeed"
+    };
+
+    enum Source {
+        UNKNOWN,
+        OPTIMISTIC,
+        CONFIRMED,
+        PUSHED,
+        STORED
+    };
+
+    static constexpr const char* sourceNames[] = {"unknown", "optimistic", "confirmed", "pushed", "stored"};
+
+    struct Entry {
+        int value = 0;
+        Source source = UNKNOWN;
+        uint64_t ts = 0;      // time_us_64() of the last update
+        uint32_t version = 0; // bumped when value changes
+        bool failed = false;  // the last write was rejected and rolled back
+
+        // what the camera last said, rollback target
+        int goodValue = 0;
+        Source goodSource = UNKNOWN;
+
+        bool pending() const {
+            return source == OPTIMISTIC;
+        }
+    };
+
+    typedef void (*Listener)(Property prop, const Entry& entry, void* ctx);
+
+    static const int MAX_LISTENERS = 4;
+
+    // value as we know it, a default until the camera told us
+    int get(Property prop) const {
+        return entries[prop].value;
+    }
+
+    const Entry& entry(Property prop) const {
+        return entries[prop];
+    }
+
+    bool known(Property prop) const {
+        return entries[prop].source != UNKNOWN;
+    }
+
+    // sum of all property versions, changes whenever any value changed
+    uint32_t version() const {
+        return totalVersion;
+    }
+
+    // pending / failed markers changed somewhere
+    uint32_t statusVersion() const {
+        return totalStatusVersion;
+    }
+
+    // record a value. returns true (and notifies) if the value changed
+    bool set(Property prop, int value, Source source) {
+        Entry& e = entries[prop];
+        bool changed = e.source == UNKNOWN || e.value != value;
+
+        if (e.failed || e.pending() != (source == OPTIMISTIC)) {
+            totalStatusVersion++;
+        }
+        e.failed = false;
+        e.source = source;
+        e.ts = time_us_64();
+
+        if (source != OPTIMISTIC) {
+            e.goodValue = value;
+            e.goodSource = source;
+        }
+
+        return changed && change(prop, value);
+    }
+
+    // an older write was acknowledged while a newer one is pending: the
+    // camera holds this value now, but keep showing the newer one
+    void setGood(Property prop, int value, Source source) {
+        entries[prop].goodValue = value;
+        entries[prop].goodSource = source;
+    }
+
+    // the camera refused the pending write: back to its last known value
+    bool rollback(Property prop) {
+        Entry& e = entries[prop];
+
+        e.failed = true;
+        e.source = e.goodSource;
+        e.ts = time_us_64();
+        totalStatusVersion++;
+
+        TRACE(TRACE_CAT_APP, TRACE_EV_APP_ROLLBACK, prop, e.goodValue);
+
+        return e.value != e.goodValue && change(prop, e.goodValue);
+    }
+
+    // initial value before anything is known, no notification
+    void setDefault(Property prop, int value) {
+        entries[prop].value = value;
+        entries[prop].goodValue = value;
+    }
+
+    bool subscribe(Listener fn, void* ctx) {
+        if (numListeners >= MAX_LISTENERS) {
+            printf("camera state: no room for listener\n");
+            return false;
+        }
+        listeners[numListeners++] = {fn, ctx};
+        return true;
+    }
+
+    void print() const {
+        uint64_t now = time_us_64();
+        for (int p = 0; p < NUM_PROPERTIES; p++) {
+            const Entry& e = entries[p];
+            if (e.source == UNKNOWN) {
+                printf("  %-10s %6d  unknown%s\n", propertyNames[p], e.value, e.failed ? " FAILED" : "");
+                continue;
+            }
+            printf("  %-10s %6d  %-10s v%lu %llu ms ago%s\n", propertyNames[p], e.value, sourceNames[e.source],
+                (unsigned long)e.version, (unsigned long long)((now - e.ts) / 1000), e.failed ? " FAILED" : "");
+        }
+    }
+
+private:
+    bool change(Property prop, int value) {
+        Entry& e = entries[prop];
+        e.value = value;
+        e.version++;
+        totalVersion++;
+
+        TRACE(TRACE_CAT_APP, TRACE_EV_APP_PROPERTY, prop, value);
+
+        for (int i = 0; i < numListeners; i++) {
+            listeners[i].fn(prop, e, listeners[i].ctx);
+        }
+        return true;
+    }
+
+    struct ListenerSlot {
+        Listener fn;
+        void* ctx;
+    };
+
+    Entry entries[NUM_PROPERTIES];
+    uint32_t totalVersion = 0;
+    uint32_t totalStatusVersion = 0;
+
+    ListenerSlot listeners[MAX_LISTENERS];
+    int numListeners = 0;
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * line oriented command console on stdio (uart and usb cdc).
+ *
+ * poll() is called from the main loop and never blocks. a complete line is
+ * split on spaces and handed to the matching command. after the command ran
+ * the console prints "OK" or "ERR", so a script can send a line and read up
+ * to the status line without knowing the output of each command.
+ */
+class Console {
+public:
+    static const int MAX_COMMANDS = 32;
+    static const int MAX_LINE = 128;
+    static const int MAX_ARGS = 8;
+
+    // argv[0] is the command name. return false (after printing why) on bad input
+    typedef bool (*Handler)(int argc, char** argv, void* ctx);
+
+    struct Command {
+        const char* name;
+        const char* usage;
+        Handler handler;
+        void* ctx;
+    };
+
+    bool echo = true;
+
+    Console() {
+        add("help", "list commands", helpCommand, this);
+        add("echo", "on|off", echoCommand, this);
+    }
+
+    bool add(const char* name, const char* usage, Handler handler, void* ctx) {
+        if (numCommands >= MAX_COMMANDS) {
+            printf("console: no room for command %s\n", name);
+            return false;
+        }
+
+        commands[numCommands++] = {name, usage, handler, ctx};
+        return true;
+    }
+
+    // read whatever input is pending and run complete lines
+    void poll() {
+        int c;
+        while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+            if (c == '\r' || c == '\n') {
+                if (echo) {
+                    printf("\n");
+                }
+                if (length > 0) {
+                    line[length] = 0;
+                    execute(line);
+                    length = 0;
+                }
+            } else if (c == '\b' || c == 0x7f) {
+                if (length > 0) {
+                    length--;
+                    if (echo) {
+                        printf("\b \b");
+                    }
+                }
+            } else if (c >= ' ' && length < MAX_LINE - 1) {
+                line[length++] = (char)c;
+                if (echo) {
+                    putchar(c);
+                }
+            }
+        }
+    }
+
+    // run one command line, line is modified
+    bool execute(char* cmdline) {
+        char* argv[MAX_ARGS];
+        int argc = 0;
+
+        char* save = nullptr;
+        for (char* tok = strtok_r(cmdline, " \t", &save); tok && argc < MAX_ARGS; tok = strtok_r(nullptr, " \t", &save)) {
+            argv[argc++] = tok;
+        }
+
+        if (argc == 0) {
+            return true;
+        }
+
+        const Command* cmd = find(argv[0]);
+        if (cmd == nullptr) {
+            printf("unknown command '%s', try help\nERR\n", argv[0]);
+            return false;
+        }
+
+        bool ok = cmd->handler(argc, argv, cmd->ctx);
+        printf(ok ? "OK\n" : "ERR\n");
+        return ok;
+    }
+
+    const Command* find(const char* name) const {
+        for (int i = 0; i < numCommands; i++) {
+            if (strcmp(commands[i].name, name) == 0) {
+                return &commands[i];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    Command commands[MAX_COMMANDS];
+    int numCommands = 0;
+
+    char line[MAX_LINE];
+    int length = 0;
+
+    static bool helpCommand(int, char**, void* ctx) {
+        Console* console = (Console*)ctx;
+        for (int i = 0; i < console->numCommands; i++) {
+            printf("  %-10s %s\n", console->commands[i].name, console->commands[i].usage);
+        }
+        return true;
+    }
+
+    static bool echoCommand(int argc, char** argv, void* ctx) {
+        Console* console = (Console*)ctx;
+        if (argc != 2) {
+            printf("echo is %s\n", console->echo ? "on" : "off");
+            return argc == 1;
+        }
+        console->echo = strcmp(argv[1], "on") == 0;
+        return true;
+    }
+};
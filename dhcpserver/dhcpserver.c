@@ -37,6 +37,7 @@
 #include <pico/time.h>
 
 #include "dhcpserver.h"
+#include "trace.h"
 
 #define DHCPDISCOVER (1)
 #define DHCPOFFER (2)
@@ -54,12 +55,14 @@
 #define DHCP_OPT_HOST_NAME (12)
 #define DHCP_OPT_REQUESTED_IP (50)
 #define DHCP_OPT_IP_LEASE_TIME (51)
+#define DHCP_OPT_OVERLOAD (52)
 #define DHCP_OPT_MSG_TYPE (53)
 #define DHCP_OPT_SERVER_ID (54)
 #define DHCP_OPT_PARAM_REQUEST_LIST (55)
 #define DHCP_OPT_MAX_MSG_SIZE (57)
 #define DHCP_OPT_VENDOR_CLASS_ID (60)
 #define DHCP_OPT_CLIENT_ID (61)
+#define DHCP_OPT_RAPID_COMMIT (80)
 #define DHCP_OPT_END (255)
 
 #define PORT_DHCP_SERVER (67)
@@ -86,7 +89,38 @@ typedef struct {
     uint8_t sname[64]; // server host name
     uint8_t file[128]; // boot file name
     uint8_t options[312]; // optional parameters, variable, starts with magic
-} dhcp_msg_t;
+} __attribute__((packed)) dhcp_msg_t; // lives at an odd offset in the reply pbuf
+
+#define DHCP_SNAME_OFS (44)
+#define DHCP_FILE_OFS (108)
+#define DHCP_OPTIONS_OFS (236)
+#define DHCP_MIN_SIZE (DHCP_OPTIONS_OFS + 4 + 3)
+
+// fixed part, cookie and room for the handful of options a reply carries
+#define DHCP_REPLY_SIZE (DHCP_OPTIONS_OFS + 4 + 64)
+
+static const uint8_t dhcp_cookie[4] = {99, 130, 83, 99};
+
+// the options the server reads, indexed in one pass over the request
+enum {
+  OPT_MSG_TYPE,
+  OPT_REQUESTED_IP,
+  OPT_SERVER_ID,
+  OPT_HOST_NAME,
+  OPT_RAPID_COMMIT,
+  OPT_OVERLOAD,
+  NUM_OPTS
+};
+
+// where an option's data is in the packet, off 0 means absent (data never starts at 0)
+typedef struct {
+  uint16_t off;
+  uint8_t len;
+} dhcp_opt_ref_t;
+
+typedef struct {
+  dhcp_opt_ref_t ref[NUM_OPTS];
+} dhcp_opts_t;
 
 static inline uint32_t get_ticks_ms(void) {
   return to_ms_since_boot(get_absolute_time());
@@ -119,28 +153,37 @@ static int dhcp_socket_bind(struct udp_pcb **udp, uint16_t port) {
   return udp_bind(*udp, IP_ANY_TYPE, port);
 }
 
-static int dhcp_socket_sendto(struct udp_pcb **udp, struct netif *nif, const void *buf, size_t len, uint32_t ip, uint16_t port) {
-  if (len > 0xffff) {
-    len = 0xffff;
-  }
-
-  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
-  if (p == NULL) {
-    return -ENOMEM;
-  }
-
-  memcpy(p->payload, buf, len);
+// send the reply sitting in d->tx, to broadcast or to a client that already has
+// an address (to). the pbuf is reused for every reply, so a unicast goes out on
+// a copy: it can sit in the ARP queue, headers and all, until the client answers
+static int dhcp_socket_send_reply(dhcp_server_t *d, struct netif *nif, size_t len, uint16_t port, const ip_addr_t *to) {
+  struct pbuf *p = d->tx;
+  p->len = p->tot_len = len;
 
   ip_addr_t dest;
-  IP4_ADDR(ip_2_ip4(&dest), ip >> 24 & 0xff, ip >> 16 & 0xff, ip >> 8 & 0xff, ip & 0xff);
+  if (to != NULL) {
+    p = pbuf_clone(PBUF_TRANSPORT, PBUF_RAM, d->tx);
+    if (p == NULL) {
+      return ERR_MEM;
+    }
+    ip_addr_copy(dest, *to);
+  } else {
+    IP4_ADDR(ip_2_ip4(&dest), 255, 255, 255, 255);
+  }
   err_t err;
   if (nif != NULL) {
-    err = udp_sendto_if(*udp, p, &dest, port, nif);
+    err = udp_sendto_if(d->udp, p, &dest, port, nif);
   } else {
-    err = udp_sendto(*udp, p, &dest, port);
+    err = udp_sendto(d->udp, p, &dest, port);
   }
 
-  pbuf_free(p);
+  if (p != d->tx) {
+    // lwIP holds its own reference while the copy waits for ARP
+    pbuf_free(p);
+  } else if (p->payload != d->tx_msg) {
+    // udp / ip / ethernet headers were prepended in place, step back over them
+    pbuf_remove_header(p, (uint8_t *)d->tx_msg - (uint8_t *)p->payload);
+  }
 
   if (err != ERR_OK) {
     return err;
@@ -149,21 +192,91 @@ static int dhcp_socket_sendto(struct udp_pcb **udp, struct netif *nif, const voi
   return len;
 }
 
-static uint8_t *opt_find(uint8_t *opt, uint8_t cmd) {
-  for (int i = 0; i < 308 && opt[i] != DHCP_OPT_END;) {
-    if (opt[i] == cmd) {
-      return &opt[i];
+// reads a pbuf chain front to back without copying it
+typedef struct {
+  const struct pbuf *q;
+  uint16_t base; // packet offset of q->payload
+} pbuf_cursor_t;
+
+static inline uint8_t cursor_get(pbuf_cursor_t *c, uint16_t off) {
+  while (off >= c->base + c->q->len) {
+    c->base += c->q->len;
+    c->q = c->q->next;
+  }
+  return ((const uint8_t *)c->q->payload)[off - c->base];
+}
+
+static int opt_slot(uint8_t code) {
+  switch (code) {
+    case DHCP_OPT_MSG_TYPE: return OPT_MSG_TYPE;
+    case DHCP_OPT_REQUESTED_IP: return OPT_REQUESTED_IP;
+    case DHCP_OPT_SERVER_ID: return OPT_SERVER_ID;
+    case DHCP_OPT_HOST_NAME: return OPT_HOST_NAME;
+    case DHCP_OPT_RAPID_COMMIT: return OPT_RAPID_COMMIT;
+    case DHCP_OPT_OVERLOAD: return OPT_OVERLOAD;
+    default: return -1;
+  }
+}
+
+// index the options in [start, end) of the packet. the first instance of an
+// option wins, rfc 3396 long options split over several instances aren't joined
+static void opt_scan(const struct pbuf *p, uint16_t start, uint16_t end, dhcp_opts_t *opts) {
+  pbuf_cursor_t c = {p, 0};
+  uint16_t i = start;
+  while (i < end) {
+    uint8_t code = cursor_get(&c, i);
+    if (code == DHCP_OPT_PAD) {
+      i++;
+      continue;
+    }
+    if (code == DHCP_OPT_END || i + 1 >= end) {
+      break;
+    }
+    uint8_t len = cursor_get(&c, i + 1);
+    if (i + 2 + len > end) {
+      // truncated
+      break;
+    }
+    int slot = opt_slot(code);
+    if (slot >= 0 && opts->ref[slot].off == 0) {
+      opts->ref[slot].off = i + 2;
+      opts->ref[slot].len = len;
     }
-    i += 2 + opt[i + 1];
+    i += 2 + len;
+  }
+}
+
+// all options of a request: the options field (up to the whole packet), then
+// file and sname if option 52 says they carry options too
+static void opt_index(const struct pbuf *p, dhcp_opts_t *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opt_scan(p, DHCP_OPTIONS_OFS + 4, p->tot_len, opts);
+
+  const dhcp_opt_ref_t *overload = &opts->ref[OPT_OVERLOAD];
+  if (overload->off == 0 || overload->len != 1) {
+    return;
+  }
+  uint8_t fields = pbuf_get_at(p, overload->off);
+  if (fields & 1) {
+    opt_scan(p, DHCP_FILE_OFS, DHCP_OPTIONS_OFS, opts);
+  }
+  if (fields & 2) {
+    opt_scan(p, DHCP_SNAME_OFS, DHCP_FILE_OFS, opts);
   }
-  return NULL;
+}
+
+// copy an option's data if it has exactly len bytes
+static bool opt_read(const struct pbuf *p, const dhcp_opt_ref_t *ref, void *buf, uint8_t len) {
+  return ref->off != 0 && ref->len == len && pbuf_copy_partial(p, buf, len, ref->off) == len;
 }
 
 static void opt_write_n(uint8_t **opt, uint8_t cmd, size_t n, const void *data) {
   uint8_t *o = *opt;
   *o++ = cmd;
   *o++ = n;
-  memcpy(o, data, n);
+  if (n > 0) {
+    memcpy(o, data, n);
+  }
   *opt = o + n;
 }
 
@@ -186,100 +299,157 @@ static void opt_write_u32(uint8_t **opt, uint8_t cmd, uint32_t val) {
   *opt = o;
 }
 
+// index of the lease for mac: its own, else a free or expired one. DHCPS_MAX_IP if the pool is full
+static int lease_pick(dhcp_server_t *d, const uint8_t *mac) {
+  int yi = DHCPS_MAX_IP;
+  for (int i = 0; i < DHCPS_MAX_IP; ++i) {
+    if (memcmp(d->lease[i].mac, mac, MAC_LEN) == 0) {
+      // MAC match, use this IP address
+      return i;
+    }
+    if (yi == DHCPS_MAX_IP) {
+      // Look for a free IP address
+      if (memcmp(d->lease[i].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0) {
+        // IP available
+        yi = i;
+      }
+      uint32_t expiry = d->lease[i].expiry << 16 | 0xffff;
+      if ((int32_t)(expiry - get_ticks_ms()) < 0) {
+        // IP expired, reuse it
+        memset(d->lease[i].mac, 0, MAC_LEN);
+        yi = i;
+      }
+    }
+  }
+  return yi;
+}
+
+// lease index of a client address in our pool, DHCPS_MAX_IP if it isn't one
+static int lease_index(dhcp_server_t *d, const uint8_t *ip) {
+  if (memcmp(ip, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 3) != 0) {
+    return DHCPS_MAX_IP;
+  }
+  int yi = ip[3] - DHCPS_BASE_IP;
+  return yi >= 0 && yi < DHCPS_MAX_IP ? yi : DHCPS_MAX_IP;
+}
+
 static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *src_addr, u16_t src_port) {
   dhcp_server_t *d = arg;
   (void)upcb;
   (void)src_addr;
   (void)src_port;
 
-  // This is around 548 bytes
-  dhcp_msg_t dhcp_msg;
-
-#define DHCP_MIN_SIZE (240 + 3)
-  if (p->tot_len < DHCP_MIN_SIZE) {
+  if (p->tot_len < DHCP_MIN_SIZE || pbuf_memcmp(p, DHCP_OPTIONS_OFS, dhcp_cookie, 4) != 0) {
     goto ignore_request;
   }
-
-  size_t len = pbuf_copy_partial(p, &dhcp_msg, sizeof(dhcp_msg), 0);
-  if (len < DHCP_MIN_SIZE) {
+  if (d->tx == NULL || d->tx->ref != 1) {
+    // no reply buffer, or the last reply is still queued: the client retries
     goto ignore_request;
   }
 
-  dhcp_msg.op = DHCPOFFER;
-  memcpy(&dhcp_msg.yiaddr, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4);
-
-  uint8_t *opt = (uint8_t *)&dhcp_msg.options;
-  opt += 4; // assume magic cookie: 99, 130, 83, 99
+  dhcp_opts_t opts;
+  opt_index(p, &opts);
 
-  uint8_t *msgtype = opt_find(opt, DHCP_OPT_MSG_TYPE);
-  if (msgtype == NULL) {
+  uint8_t type;
+  if (!opt_read(p, &opts.ref[OPT_MSG_TYPE], &type, 1)) {
     // A DHCP package without MSG_TYPE?
     goto ignore_request;
   }
 
-  switch (msgtype[2]) {
+  uint8_t requested[4] = {0};
+  opt_read(p, &opts.ref[OPT_REQUESTED_IP], requested, 4);
+  uint8_t server_id[4];
+  bool other_server = opt_read(p, &opts.ref[OPT_SERVER_ID], server_id, 4) &&
+    memcmp(server_id, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4) != 0;
+  bool rapid_commit = opts.ref[OPT_RAPID_COMMIT].off != 0;
+  char hostname[DHCPS_HOSTNAME_LEN + 1] = "";
+  const dhcp_opt_ref_t *hn = &opts.ref[OPT_HOST_NAME];
+  if (hn->off != 0) {
+    size_t n = hn->len < DHCPS_HOSTNAME_LEN ? hn->len : DHCPS_HOSTNAME_LEN;
+    pbuf_copy_partial(p, hostname, n, hn->off);
+    hostname[n] = 0;
+  }
+
+  // the reply starts as the request's fixed part up to chaddr, sname and file empty
+  dhcp_msg_t *msg = d->tx_msg;
+  pbuf_copy_partial(p, msg, DHCP_SNAME_OFS, 0);
+  memset(msg->sname, 0, sizeof(msg->sname) + sizeof(msg->file));
+  memcpy(msg->options, dhcp_cookie, 4);
+  uint8_t *opt = msg->options + 4;
+
+  msg->op = DHCPOFFER;
+  memcpy(&msg->yiaddr, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4);
+
+  // last four bytes of the client mac, enough to tell clients apart in a trace
+  uint32_t mac_tail = (uint32_t)msg->chaddr[2] << 24 | msg->chaddr[3] << 16 | msg->chaddr[4] << 8 | msg->chaddr[5];
+
+  int yi = DHCPS_MAX_IP;
+  uint8_t reply;
+
+  switch (type) {
     case DHCPDISCOVER: {
-      int yi = DHCPS_MAX_IP;
-      for (int i = 0; i < DHCPS_MAX_IP; ++i) {
-        if (memcmp(d->lease[i].mac, dhcp_msg.chaddr, MAC_LEN) == 0) {
-          // MAC match, use this IP address
-          yi = i;
-          break;
-        }
-        if (yi == DHCPS_MAX_IP) {
-          // Look for a free IP address
-          if (memcmp(d->lease[i].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0) {
-            // IP available
-            yi = i;
-          }
-          uint32_t expiry = d->lease[i].expiry << 16 | 0xffff;
-          if ((int32_t)(expiry - get_ticks_ms()) < 0) {
-            // IP expired, reuse it
-            memset(d->lease[i].mac, 0, MAC_LEN);
-            yi = i;
-          }
-        }
-      }
+      TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_DISCOVER, rapid_commit, mac_tail);
+      yi = lease_pick(d, msg->chaddr);
       if (yi == DHCPS_MAX_IP) {
         // No more IP addresses left
         goto ignore_request;
       }
-      dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-      opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPOFFER);
+      if (rapid_commit) {
+        // rfc 4039: the client takes an ACK straight away, skipping OFFER / REQUEST
+        memcpy(d->lease[yi].mac, msg->chaddr, MAC_LEN);
+        reply = DHCPACK;
+      } else {
+        msg->yiaddr[3] = DHCPS_BASE_IP + yi;
+        reply = DHCPOFFER;
+        TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_OFFER, msg->yiaddr[3], mac_tail);
+      }
       break;
     }
 
     case DHCPREQUEST: {
-      uint8_t *o = opt_find(opt, DHCP_OPT_REQUESTED_IP);
-      if (o == NULL) {
-        // Should be NACK
+      TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_REQUEST, 0, mac_tail);
+      if (other_server) {
+        // the client took another server's offer
         goto ignore_request;
       }
-      if (memcmp(o + 2, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 3) != 0) {
-        // Should be NACK
-        goto ignore_request;
-      }
-      uint8_t yi = o[5] - DHCPS_BASE_IP;
-      if (yi >= DHCPS_MAX_IP) {
-        // Should be NACK
-        goto ignore_request;
+      // selecting / init-reboot name the address in option 50, renewing / rebinding in ciaddr
+      const uint8_t *ip = requested[0] != 0 ? requested : msg->ciaddr;
+      yi = lease_index(d, ip);
+      if (yi == DHCPS_MAX_IP) {
+        // not one of ours, e.g. a lease from another network: tell the client to start over
+        reply = DHCPNACK;
+        break;
       }
-      if (memcmp(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN) == 0) {
+      if (memcmp(d->lease[yi].mac, msg->chaddr, MAC_LEN) == 0) {
         // MAC match, ok to use this IP address
       } else if (memcmp(d->lease[yi].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0) {
         // IP unused, ok to use this IP address
-        memcpy(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN);
+        memcpy(d->lease[yi].mac, msg->chaddr, MAC_LEN);
       } else {
         // IP already in use
-        // Should be NACK
-        goto ignore_request;
+        reply = DHCPNACK;
+        break;
       }
-      d->lease[yi].expiry = (get_ticks_ms() + DEFAULT_LEASE_TIME_S * 1000) >> 16;
-      dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-      opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPACK);
-      printf("DHCPS: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u\n", dhcp_msg.chaddr[0], dhcp_msg.chaddr[1],
-        dhcp_msg.chaddr[2], dhcp_msg.chaddr[3], dhcp_msg.chaddr[4], dhcp_msg.chaddr[5], dhcp_msg.yiaddr[0], dhcp_msg.yiaddr[1], dhcp_msg.yiaddr[2],
-        dhcp_msg.yiaddr[3]);
+      reply = DHCPACK;
+      break;
+    }
+
+    case DHCPRELEASE: {
+      yi = lease_index(d, msg->ciaddr);
+      TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_RELEASE, msg->ciaddr[3], mac_tail);
+      if (yi != DHCPS_MAX_IP && memcmp(d->lease[yi].mac, msg->chaddr, MAC_LEN) == 0) {
+        memset(d->lease[yi].mac, 0, MAC_LEN);
+        printf("DHCPS: released %u.%u.%u.%u\n", msg->ciaddr[0], msg->ciaddr[1], msg->ciaddr[2], msg->ciaddr[3]);
+      }
+      // no reply
+      goto ignore_request;
+    }
+
+    case DHCPINFORM: {
+      // configured by hand, only wants the other parameters: no address, no lease time
+      TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_INFORM, msg->ciaddr[3], mac_tail);
+      memset(msg->yiaddr, 0, 4);
+      reply = DHCPACK;
       break;
     }
 
@@ -287,16 +457,63 @@ static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
       goto ignore_request;
   }
 
+  opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, reply);
   opt_write_n(&opt, DHCP_OPT_SERVER_ID, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));
+
+  if (reply == DHCPNACK) {
+    // no address and no parameters, the client goes back to DISCOVER right away
+    TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_NAK, (requested[0] != 0 ? requested : msg->ciaddr)[3], mac_tail);
+    memset(msg->yiaddr, 0, 4);
+    memset(msg->ciaddr, 0, 4);
+    *opt++ = DHCP_OPT_END;
+    dhcp_socket_send_reply(d, ip_current_input_netif(), opt - (uint8_t *)msg, PORT_DHCP_CLIENT, NULL);
+    goto ignore_request;
+  }
+
+  // filled in on ACK, reported once the reply is out
+  bool bound = reply == DHCPACK && type != DHCPINFORM;
+  dhcp_server_lease_event_t ev;
+
+  if (bound) {
+    d->lease[yi].expiry = (get_ticks_ms() + DEFAULT_LEASE_TIME_S * 1000) >> 16;
+    msg->yiaddr[3] = DHCPS_BASE_IP + yi;
+    if (type == DHCPDISCOVER) {
+      opt_write_n(&opt, DHCP_OPT_RAPID_COMMIT, 0, NULL);
+    }
+    TRACE(TRACE_CAT_DHCP, TRACE_EV_DHCP_ACK, msg->yiaddr[3], mac_tail);
+
+    memcpy(ev.mac, msg->chaddr, MAC_LEN);
+    IP_ADDR4(&ev.ip, msg->yiaddr[0], msg->yiaddr[1], msg->yiaddr[2], msg->yiaddr[3]);
+    memcpy(ev.hostname, hostname, sizeof(ev.hostname));
+
+    printf("DHCPS: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u host=%s%s\n", msg->chaddr[0], msg->chaddr[1],
+      msg->chaddr[2], msg->chaddr[3], msg->chaddr[4], msg->chaddr[5], msg->yiaddr[0], msg->yiaddr[1], msg->yiaddr[2],
+      msg->yiaddr[3], ev.hostname, type == DHCPDISCOVER ? " (rapid commit)" : "");
+  }
+
   opt_write_n(&opt, DHCP_OPT_SUBNET_MASK, 4, &ip4_addr_get_u32(ip_2_ip4(&d->nm)));
   if (d->set_router_and_dns) {
     opt_write_n(&opt, DHCP_OPT_ROUTER, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // aka gateway; can have multiple addresses
     opt_write_n(&opt, DHCP_OPT_DNS, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // this server is the dns
   }
-  opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
+  if (type != DHCPINFORM) {
+    opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
+  }
   *opt++ = DHCP_OPT_END;
   struct netif *nif = ip_current_input_netif();
-  dhcp_socket_sendto(&d->udp, nif, &dhcp_msg, opt - (uint8_t *)&dhcp_msg, 0xffffffff, PORT_DHCP_CLIENT);
+  // rfc 2131 4.3.5: the ACK to an INFORM goes straight to ciaddr, the client is
+  // configured already. broadcast only if it didn't say its address
+  ip_addr_t client;
+  const ip_addr_t *to = NULL;
+  if (type == DHCPINFORM && memcmp(msg->ciaddr, "\x00\x00\x00\x00", 4) != 0) {
+    IP_ADDR4(&client, msg->ciaddr[0], msg->ciaddr[1], msg->ciaddr[2], msg->ciaddr[3]);
+    to = &client;
+  }
+  dhcp_socket_send_reply(d, nif, opt - (uint8_t *)msg, PORT_DHCP_CLIENT, to);
+
+  if (bound && d->lease_cb != NULL) {
+    d->lease_cb(d->lease_cb_arg, &ev);
+  }
 
 ignore_request:
   pbuf_free(p);
@@ -307,6 +524,14 @@ void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm, bool set_r
   ip_addr_copy(d->nm, *nm);
   d->set_router_and_dns = set_router_and_dns;
   memset(d->lease, 0, sizeof(d->lease));
+  d->lease_cb = NULL;
+  d->lease_cb_arg = NULL;
+  // one reply buffer for the server's lifetime, with room for the headers in front
+  d->tx = pbuf_alloc(PBUF_TRANSPORT, DHCP_REPLY_SIZE, PBUF_RAM);
+  d->tx_msg = d->tx != NULL ? d->tx->payload : NULL;
+  if (d->tx == NULL) {
+    printf("DHCPS: no memory for the reply buffer\n");
+  }
   if (dhcp_socket_new_dgram(&d->udp, d, dhcp_server_process) != 0) {
     return;
   }
@@ -315,4 +540,22 @@ void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm, bool set_r
 
 void dhcp_server_deinit(dhcp_server_t *d) {
   dhcp_socket_free(&d->udp);
+  if (d->tx != NULL) {
+    pbuf_free(d->tx);
+    d->tx = NULL;
+  }
+}
+
+void dhcp_server_set_lease_callback(dhcp_server_t *d, dhcp_server_lease_cb_t cb, void *arg) {
+  d->lease_cb = cb;
+  d->lease_cb_arg = arg;
+}
+
+void dhcp_server_preload(dhcp_server_t *d, int i, const uint8_t *mac) {
+  memcpy(d->lease[i].mac, mac, MAC_LEN);
+  d->lease[i].expiry = (get_ticks_ms() + DEFAULT_LEASE_TIME_S * 1000) >> 16;
+}
+
+bool dhcp_server_is_leased(const dhcp_server_t *d, int i) {
+  return memcmp(d->lease[i].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) != 0;
 }
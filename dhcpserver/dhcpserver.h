@@ -44,17 +44,42 @@ typedef struct _dhcp_server_lease_t {
     uint16_t expiry;
 } dhcp_server_lease_t;
 
+#define DHCPS_HOSTNAME_LEN (32)
+
+typedef struct _dhcp_server_lease_event_t {
+    uint8_t mac[6];
+    ip_addr_t ip;
+    char hostname[DHCPS_HOSTNAME_LEN + 1]; // option 12, empty if the client sent none
+} dhcp_server_lease_event_t;
+
+// called from the lwIP udp callback right after the ACK went out, so the
+// application can start talking to the client immediately
+typedef void (*dhcp_server_lease_cb_t)(void *arg, const dhcp_server_lease_event_t *ev);
+
 typedef struct _dhcp_server_t {
     ip_addr_t ip;
     ip_addr_t nm;
     bool set_router_and_dns;
     dhcp_server_lease_t lease[DHCPS_MAX_IP];
     struct udp_pcb *udp;
+    dhcp_server_lease_cb_t lease_cb;
+    void *lease_cb_arg;
+    struct pbuf *tx; // reply buffer, allocated once in dhcp_server_init()
+    void *tx_msg;    // the dhcp message in tx, behind the room for headers
 } dhcp_server_t;
 
 void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm, bool set_router_and_dns);
 void dhcp_server_deinit(dhcp_server_t *d);
 
+void dhcp_server_set_lease_callback(dhcp_server_t *d, dhcp_server_lease_cb_t cb, void *arg);
+
+// hand lease i to mac again, e.g. the camera's address from before a power
+// cycle: its REQUEST for the old address is acked instead of starting over
+void dhcp_server_preload(dhcp_server_t *d, int i, const uint8_t *mac);
+
+// true if lease i (address DHCPS_BASE_IP + i) has been handed out
+bool dhcp_server_is_leased(const dhcp_server_t *d, int i);
+
 #ifdef __cplusplus
 }
 #endif
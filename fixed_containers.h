@@ -0,0 +1,216 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+#include <utility>
+
+/**
+ * fixed capacity replacements for the std containers used by the firmware.
+ * storage is part of the object, nothing is ever allocated, and running out
+ * of room is reported to the caller instead of growing.
+ */
+
+/* string ======================================= */
+
+template <size_t N>
+class FixedString {
+public:
+    static const size_t npos = (size_t)-1;
+
+    FixedString() {
+        clear();
+    }
+
+    void clear() {
+        len = 0;
+        buff[0] = 0;
+    }
+
+    // false if the text had to be cut to fit
+    bool assign(const char* s) {
+        clear();
+        return append(s, strlen(s));
+    }
+
+    bool append(const char* s, size_t n) {
+        bool fits = len + n <= N;
+        if (!fits) {
+            n = N - len;
+        }
+        memcpy(buff + len, s, n);
+        len += n;
+        buff[len] = 0;
+        return fits;
+    }
+
+    // snprintf into the string, false if the result was truncated
+    bool format(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buff, N + 1, fmt, args);
+        va_end(args);
+
+        if (n < 0) {
+            clear();
+            return false;
+        }
+        len = (size_t)n > N ? N : (size_t)n;
+        return (size_t)n <= N;
+    }
+
+    // drop everything from n on
+    void truncate(size_t n) {
+        if (n < len) {
+            len = n;
+            buff[len] = 0;
+        }
+    }
+
+    const char* c_str() const {
+        return buff;
+    }
+
+    size_t size() const {
+        return len;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    char buff[N + 1];
+    size_t len;
+};
+
+/* vector ======================================= */
+
+template <typename T, size_t N>
+class FixedVector {
+public:
+    bool push_back(const T& value) {
+        if (count >= N) {
+            return false;
+        }
+        items[count++] = value;
+        return true;
+    }
+
+    // keeps the order of the remaining items
+    void erase(size_t index) {
+        for (size_t i = index; i + 1 < count; i++) {
+            items[i] = items[i + 1];
+        }
+        count--;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    T& operator[](size_t i) {
+        return items[i];
+    }
+
+    const T& operator[](size_t i) const {
+        return items[i];
+    }
+
+    T& front() {
+        return items[0];
+    }
+
+    T* begin() {
+        return items;
+    }
+
+    T* end() {
+        return items + count;
+    }
+
+    const T* begin() const {
+        return items;
+    }
+
+    const T* end() const {
+        return items + count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    bool full() const {
+        return count == N;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    T items[N];
+    size_t count = 0;
+};
+
+/* object pool ================================== */
+
+/**
+ * N slots for objects of type T. create() constructs in a free slot and
+ * returns nullptr when all are taken, destroy() gives the slot back.
+ */
+template <typename T, size_t N>
+class ObjectPool {
+public:
+    template <typename... Args>
+    T* create(Args&&... args) {
+        for (size_t i = 0; i < N; i++) {
+            if (!used[i]) {
+                used[i] = true;
+                inUse++;
+                if (inUse > highWater) {
+                    highWater = inUse;
+                }
+                return new (&slots[i]) T(std::forward<Args>(args)...);
+            }
+        }
+
+        failures++;
+        return nullptr;
+    }
+
+    void destroy(T* obj) {
+        size_t i = (Slot*)obj - slots;
+        if (obj == nullptr || i >= N || !used[i]) {
+            return;
+        }
+        obj->~T();
+        used[i] = false;
+        inUse--;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+    size_t inUse = 0;
+    size_t highWater = 0;
+    uint32_t failures = 0;
+
+private:
+    struct Slot {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    Slot slots[N];
+    bool used[N] = {false};
+};
@@ -0,0 +1,246 @@
+// wear levelled record store in flash, see flash_store.h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+#include "flash_store.h"
+
+#define STORE_MAGIC 0x31534d42u // "BMS1"
+
+#if PICO_ON_DEVICE
+
+#include "hardware/flash.h"
+
+// the last sectors of flash, far above the firmware
+#define STORE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#define STORE_BASE ((const uint8_t *)(XIP_BASE + STORE_OFFSET))
+
+static void erase_range(uint32_t offset, size_t len) {
+  flash_range_erase(STORE_OFFSET + offset, len);
+}
+
+static void program_range(uint32_t offset, const void *data, size_t len) {
+  flash_range_program(STORE_OFFSET + offset, data, len);
+}
+
+#else
+
+// host build: RAM with flash semantics (erase to 0xff, program clears bits),
+// gone when the process exits
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 4096
+
+static uint8_t host_flash[FLASH_STORE_SECTORS * FLASH_SECTOR_SIZE];
+static bool host_flash_ready = false;
+#define STORE_BASE ((const uint8_t *)host_flash)
+
+static void erase_range(uint32_t offset, size_t len) {
+  memset(host_flash + offset, 0xff, len);
+}
+
+static void program_range(uint32_t offset, const void *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    host_flash[offset + i] &= ((const uint8_t *)data)[i];
+  }
+}
+
+#endif
+
+#define PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define NUM_PAGES (FLASH_STORE_SECTORS * PAGES_PER_SECTOR)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint8_t key;
+  uint8_t reserved;
+  uint16_t len;
+  uint32_t crc; // of data[0 .. len)
+  uint8_t data[FLASH_STORE_MAX_DATA];
+} store_page_t;
+
+_Static_assert(sizeof(store_page_t) == FLASH_PAGE_SIZE, "a record is one flash page");
+_Static_assert(FLASH_STORE_MAX_KEYS < FLASH_STORE_SECTORS, "need a sector without current records");
+_Static_assert(FLASH_STORE_MAX_KEYS < PAGES_PER_SECTOR, "records copied forward must fit in a sector");
+
+// newest page of each key, -1 if none
+static int latest[FLASH_STORE_MAX_KEYS + 1];
+static flash_store_stats_t stats;
+
+// the page being programmed, flash can't be read while it's written
+static store_page_t page_buf;
+
+static const store_page_t *page_at(int i) {
+  return (const store_page_t *)(STORE_BASE + i * FLASH_PAGE_SIZE);
+}
+
+static int sector_of(int page) {
+  return page / PAGES_PER_SECTOR;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = crc >> 1 ^ (0xedb88320u & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+static bool page_valid(const store_page_t *p) {
+  return p->magic == STORE_MAGIC && p->key >= 1 && p->key <= FLASH_STORE_MAX_KEYS && p->len <= FLASH_STORE_MAX_DATA &&
+    p->crc == crc32(p->data, p->len);
+}
+
+// pages [first, first + n) are erased
+static bool blank(int first, int n) {
+  const uint32_t *w = (const uint32_t *)page_at(first);
+  for (size_t i = 0; i < (size_t)n * FLASH_PAGE_SIZE / 4; i++) {
+    if (w[i] != 0xffffffffu) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void erase_sector(int s);
+
+// append a record at head. the head's sector is blank from head on
+static void program(uint8_t key, const void *data, size_t len) {
+  // data may point into the store itself, copy before flash goes away
+  memset(&page_buf, 0xff, sizeof(page_buf));
+  page_buf.magic = STORE_MAGIC;
+  page_buf.seq = ++stats.seq;
+  page_buf.key = key;
+  page_buf.len = (uint16_t)len;
+  memcpy(page_buf.data, data, len);
+  page_buf.crc = crc32(page_buf.data, len);
+
+  uint32_t ints = save_and_disable_interrupts();
+  program_range((uint32_t)stats.head * FLASH_PAGE_SIZE, &page_buf, sizeof(page_buf));
+  restore_interrupts(ints);
+
+  latest[key] = stats.head;
+  stats.writes++;
+  stats.head = (stats.head + 1) % NUM_PAGES;
+
+  // moved into the next sector (blank), clear the one after it
+  if (stats.head % PAGES_PER_SECTOR == 0) {
+    erase_sector((sector_of(stats.head) + 1) % FLASH_STORE_SECTORS);
+  }
+}
+
+// copy the current records out of sector s to head, then erase it. head
+// must not be in s
+static void erase_sector(int s) {
+  for (int k = 1; k <= FLASH_STORE_MAX_KEYS; k++) {
+    if (latest[k] >= 0 && sector_of(latest[k]) == s) {
+      const store_page_t *p = page_at(latest[k]);
+      program((uint8_t)k, p->data, p->len);
+    }
+  }
+
+  if (blank(s * PAGES_PER_SECTOR, PAGES_PER_SECTOR)) {
+    return;
+  }
+
+  uint32_t ints = save_and_disable_interrupts();
+  erase_range((uint32_t)s * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+  restore_interrupts(ints);
+  stats.erases++;
+}
+
+// restart the log in a sector that holds no current record (there always is
+// one), then make the sector after it blank
+static void repair(void) {
+  int s = 0;
+  for (; s < FLASH_STORE_SECTORS; s++) {
+    bool current = false;
+    for (int k = 1; k <= FLASH_STORE_MAX_KEYS; k++) {
+      current |= latest[k] >= 0 && sector_of(latest[k]) == s;
+    }
+    if (!current) {
+      break;
+    }
+  }
+
+  stats.head = s * PAGES_PER_SECTOR;
+  erase_sector(s);
+  erase_sector((s + 1) % FLASH_STORE_SECTORS);
+  printf("flash store: log restarted in sector %d\n", s);
+}
+
+void flash_store_init(void) {
+#if !PICO_ON_DEVICE
+  if (!host_flash_ready) {
+    memset(host_flash, 0xff, sizeof(host_flash));
+    host_flash_ready = true;
+  }
+#endif
+
+  memset(&stats, 0, sizeof(stats));
+  for (int k = 0; k <= FLASH_STORE_MAX_KEYS; k++) {
+    latest[k] = -1;
+  }
+
+  int newest = -1;
+  for (int i = 0; i < NUM_PAGES; i++) {
+    const store_page_t *p = page_at(i);
+    if (!page_valid(p)) {
+      continue;
+    }
+    if (latest[p->key] < 0 || p->seq > page_at(latest[p->key])->seq) {
+      latest[p->key] = i;
+    }
+    if (newest < 0 || p->seq > stats.seq) {
+      newest = i;
+      stats.seq = p->seq;
+    }
+  }
+  stats.head = newest < 0 ? 0 : (newest + 1) % NUM_PAGES;
+
+  // normally the rest of the head's sector and all of the next are blank.
+  // not so on fresh flash or after a reset in the middle of a write
+  int next = (sector_of(stats.head) + 1) % FLASH_STORE_SECTORS;
+  if (!blank(stats.head, PAGES_PER_SECTOR - stats.head % PAGES_PER_SECTOR) || !blank(next * PAGES_PER_SECTOR, PAGES_PER_SECTOR)) {
+    repair();
+  }
+}
+
+bool flash_store_read(uint8_t key, void *buf, size_t len) {
+  if (key < 1 || key > FLASH_STORE_MAX_KEYS || latest[key] < 0) {
+    return false;
+  }
+  const store_page_t *p = page_at(latest[key]);
+  if (p->len != len) {
+    // written by a firmware with another layout
+    return false;
+  }
+  memcpy(buf, p->data, len);
+  return true;
+}
+
+bool flash_store_write(uint8_t key, const void *buf, size_t len) {
+  if (key < 1 || key > FLASH_STORE_MAX_KEYS || len > FLASH_STORE_MAX_DATA) {
+    return false;
+  }
+  if (latest[key] >= 0) {
+    const store_page_t *p = page_at(latest[key]);
+    if (p->len == len && memcmp(p->data, buf, len) == 0) {
+      stats.skipped++;
+      return true;
+    }
+  }
+
+  program(key, buf, len);
+  return true;
+}
+
+void flash_store_get_stats(flash_store_stats_t *out) {
+  *out = stats;
+}
@@ -0,0 +1,62 @@
+// small records kept across power cycles in the last sectors of flash
+//
+// every write appends one 256 byte page (header plus up to
+// FLASH_STORE_MAX_DATA bytes) to a log that runs round-robin through
+// FLASH_STORE_SECTORS erase sectors, so a sector is erased once every
+// FLASH_STORE_SECTORS * 16 writes. a key's value is its newest page with a
+// good crc. the sector after the one being filled is kept erased; records
+// still current in it are copied forward before the erase, so a reset at any
+// point loses at most the write in progress.
+//
+// programming a page stalls everything (interrupts off, no flash access) for
+// about a millisecond, an erase for ~50 ms: write from the main loop and only
+// when something changed. writing the value a key already holds is a no-op.
+
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_STORE_SECTORS 4
+#define FLASH_STORE_MAX_DATA 240
+
+// keys, 1 .. FLASH_STORE_MAX_KEYS. fewer keys than sectors, so there is
+// always a sector without a current record to restart the log in
+enum flash_store_key {
+  FLASH_STORE_CAMERA = 1, // camera identity, lease and last settings (camera.h)
+  FLASH_STORE_PRESETS = 2, // scene presets (camera.h)
+};
+
+#define FLASH_STORE_MAX_KEYS 3
+
+typedef struct {
+  uint32_t writes;  // pages programmed, including records copied forward
+  uint32_t erases;
+  uint32_t skipped; // writes of an unchanged value
+  uint32_t seq;     // sequence number of the newest page
+  int head;         // page the next write goes to
+} flash_store_stats_t;
+
+// find the newest record of each key, repair the log after a reset during a
+// write. call once at startup, before the first read
+void flash_store_init(void);
+
+// copy key's value into buf. false if there is none or it has another length
+bool flash_store_read(uint8_t key, void *buf, size_t len);
+
+// store len bytes (at most FLASH_STORE_MAX_DATA) under key
+bool flash_store_write(uint8_t key, const void *buf, size_t len);
+
+void flash_store_get_stats(flash_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_STORE_H
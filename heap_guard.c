@@ -0,0 +1,56 @@
+// heap guard, see heap_guard.h
+
+#include <stddef.h>
+
+#include "heap_guard.h"
+
+static bool locked = false;
+
+void heap_guard_lock(void) {
+  locked = true;
+}
+
+bool heap_guard_locked(void) {
+  return locked;
+}
+
+#if BMMSC_HEAP_GUARD && PICO_ON_DEVICE
+
+#include <reent.h>
+
+#include <pico/platform.h>
+
+// newlib's reentrant allocators, everything (malloc, new, strdup, ...) ends
+// up here. the linker redirects them with --wrap, see CMakeLists.txt
+void *__real__malloc_r(struct _reent *r, size_t size);
+void *__real__calloc_r(struct _reent *r, size_t n, size_t size);
+void *__real__realloc_r(struct _reent *r, void *ptr, size_t size);
+void *__real__memalign_r(struct _reent *r, size_t align, size_t size);
+
+static void check(size_t size) {
+  if (locked) {
+    panic("heap_guard: allocation of %u bytes after startup", (unsigned)size);
+  }
+}
+
+void *__wrap__malloc_r(struct _reent *r, size_t size) {
+  check(size);
+  return __real__malloc_r(r, size);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t n, size_t size) {
+  check(n * size);
+  return __real__calloc_r(r, n, size);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size) {
+  check(size);
+  return __real__realloc_r(r, ptr, size);
+}
+
+void *__wrap__memalign_r(struct _reent *r, size_t align, size_t size) {
+  check(size);
+  return __real__memalign_r(r, align, size);
+}
+
+#endif
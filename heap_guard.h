@@ -0,0 +1,29 @@
+// heap guard for the heap-free build (cmake -DBMMSC_HEAP_GUARD=ON)
+//
+// the firmware keeps all its state in fixed size, statically allocated
+// storage (fixed_containers.h). whatever the sdk and newlib still allocate
+// happens during setup. heap_guard_lock() marks the end of setup; with the
+// guard compiled in, any malloc / calloc / realloc / new after that panics
+// with the size, so a stray allocation shows up on the bench, not late in a
+// shoot. without BMMSC_HEAP_GUARD the calls are no-ops.
+
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// from now on heap allocation is a bug
+void heap_guard_lock(void);
+
+bool heap_guard_locked(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEAP_GUARD_H
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Compare two bench_latency.json results and flag regressions.
+
+usage: bench_compare.py baseline.json current.json [--tolerance 0.2] [--percentile p95]
+
+Exits with 1 if any action's complete_us percentile grew by more than the
+tolerance (relative) or requests/sec of the burst dropped by more than it,
+and if a request took more than one data segment (runs that recorded it;
+a preset press sends several requests, one segment each).
+"""
+
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.2)
+    parser.add_argument("--percentile", default="p95")
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        base = json.load(f)
+    with open(args.current) as f:
+        cur = json.load(f)
+
+    regressed = False
+
+    for name, b in base["actions"].items():
+        c = cur["actions"].get(name)
+        if c is None:
+            print(f"{name:12s} missing in current run")
+            regressed = True
+            continue
+
+        for metric in ("camera_us", "complete_us"):
+            bv = b[metric][args.percentile]
+            cv = c[metric][args.percentile]
+            change = (cv - bv) / bv if bv else 0.0
+            flag = ""
+            if metric == "complete_us" and change > args.tolerance:
+                flag = "  REGRESSION"
+                regressed = True
+            print(f"{name:12s} {metric:12s} {args.percentile} {bv:8d} -> {cv:8d} us ({change:+.1%}){flag}")
+
+        if "tcp_segments" in b and "tcp_segments" in c:
+            bs = b["tcp_segments"]["p50"]
+            cs = c["tcp_segments"]["p50"]
+            data = c["data_segments"]["max"]
+            requests = c.get("requests", {"max": 1})["max"]
+            flag = ""
+            if data > requests:
+                flag = "  REGRESSION"
+                regressed = True
+            print(f"{name:12s} {'segments':12s} p50 {bs:8d} -> {cs:8d}, max {data} with data{flag}")
+
+        if c["failed"] > b["failed"]:
+            print(f"{name:12s} failures {b['failed']} -> {c['failed']}  REGRESSION")
+            regressed = True
+
+    brps = base["burst"]["requests_per_sec"]
+    crps = cur["burst"]["requests_per_sec"]
+    change = (crps - brps) / brps if brps else 0.0
+    flag = ""
+    if change < -args.tolerance:
+        flag = "  REGRESSION"
+        regressed = True
+    print(f"{'burst':12s} requests/sec {brps:8.1f} -> {crps:8.1f} ({change:+.1%}){flag}")
+
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
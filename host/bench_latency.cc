@@ -0,0 +1,355 @@
+// press-to-camera latency benchmark (host build)
+//
+// Drives the real three_button Camera/HttpClient/Button code over the tap link
+// against camera_emu. Button edges are injected with host_gpio_set(); debounce
+// and long press windows are skipped on the virtual clock, so each sample
+// starts (t0) at the moment the firmware is able to recognise the gesture.
+//
+// For every action it records
+//   camera_us   - t0 until camera_emu parsed the request (X-Emu-Received-Us)
+//   complete_us - t0 until the response was fully received, i.e. the moment
+//                 the app can show the new state
+//   tcp_segments, data_segments - what the firmware put on the link for the
+//                 press (host_network.h); a request should go out as exactly
+//                 one data segment. the handshake of the spare connection
+//                 opened for the next press is part of the count
+//   requests    - requests the press sent. a preset recall sends one write
+//                 per differing setting, its times are until the last one
+// and reports p50/p95/p99/max. A burst of presses measures requests/sec.
+// --no-prewarm turns off the spare connection HttpClient keeps open, run
+// once with and once without to see what the saved handshake is worth.
+// Results are written as json (--out) for bench_compare.py.
+
+#define BMMSC_NO_MAIN
+#include "three_button.cc"
+
+#include <time.h>
+
+#include "host_network.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static uint64_t realUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* stats ======================================== */
+
+class Series {
+public:
+    std::vector<uint64_t> values;
+
+    uint64_t percentile(int p) const {
+        if (values.empty()) {
+            return 0;
+        }
+        std::vector<uint64_t> v = values;
+        std::sort(v.begin(), v.end());
+        // nearest rank
+        size_t rank = (p * v.size() + 99) / 100;
+        return v[rank == 0 ? 0 : rank - 1];
+    }
+
+    std::string json() const {
+        char buff[160];
+        snprintf(buff, sizeof(buff), "{\"p50\": %llu, \"p95\": %llu, \"p99\": %llu, \"max\": %llu}",
+            (unsigned long long)percentile(50), (unsigned long long)percentile(95),
+            (unsigned long long)percentile(99), (unsigned long long)percentile(100));
+        return buff;
+    }
+};
+
+class ActionResult {
+public:
+    std::string name;
+    int gestureDelayMs; // debounce / long press window the user has to wait anyway
+    int failed = 0;
+    Series camera;
+    Series complete;
+    Series segments;
+    Series dataSegments;
+    Series requests; // sent for the press, one data segment each
+};
+
+/* bench ======================================== */
+
+class Bench {
+public:
+    enum Gesture {
+        PRESS,      // falling edge is enough
+        SHORT_PRESS, // press + release, recognised after the debounce window
+        LONG_PRESS, // held past Button::LONG_PRESS
+        CHORD       // pin and pin2 down together
+    };
+
+    static const uint NO_PIN = ~0u;
+
+    Camera& camera;
+    Buttons& buttons;
+    int timeoutMs = 2000;
+
+    Bench(Camera& _camera, Buttons& _buttons) : camera(_camera), buttons(_buttons) {}
+
+    void loopOnce() {
+        usb_network_update();
+        buttons.update(camera);
+        camera.update();
+    }
+
+    void idle(int ms) {
+        uint64_t end = realUs() + ms * 1000;
+        while (realUs() < end) {
+            loopOnce();
+        }
+    }
+
+    void releaseDoneRequests() {
+        for (HttpRequest* req : camera.httpClient.doneRequests) {
+            camera.httpClient.release(req);
+        }
+        camera.httpClient.doneRequests.clear();
+    }
+
+    // the requests started since firstId once all of them are answered, empty
+    // while any is in flight or none was started yet
+    std::vector<HttpRequest*> findDone(int firstId) {
+        std::vector<HttpRequest*> done;
+        if (camera.httpClient.cnter == firstId) {
+            return done;
+        }
+        for (HttpRequest* req : camera.httpClient.activeRequests) {
+            if (req->id >= firstId) {
+                return done;
+            }
+        }
+        for (HttpRequest* req : camera.httpClient.doneRequests) {
+            if (req->id >= firstId) {
+                done.push_back(req);
+            }
+        }
+        return done;
+    }
+
+    // bring the pin to the state where the firmware recognises the gesture
+    int perform(Gesture gesture, uint pin, uint pin2) {
+        host_gpio_set(pin, false);
+
+        if (gesture == CHORD) {
+            host_gpio_set(pin2, false);
+            return 0;
+        }
+
+        if (gesture == SHORT_PRESS) {
+            host_clock_advance_us(20 * 1000);
+            host_gpio_set(pin, true);
+            host_clock_advance_us((Button::DEBOUNCE_TIME_MS + 1) * 1000);
+            return Button::DEBOUNCE_TIME_MS;
+        }
+
+        if (gesture == LONG_PRESS) {
+            host_clock_advance_us((Button::LONG_PRESS + 1) * 1000);
+            return Button::LONG_PRESS;
+        }
+
+        return 0;
+    }
+
+    // let go of the button and let the firmware consume the release
+    void finish(uint pin, uint pin2 = NO_PIN) {
+        host_gpio_set(pin, true);
+        if (pin2 != NO_PIN) {
+            host_gpio_set(pin2, true);
+        }
+        host_clock_advance_us((Button::DEBOUNCE_TIME_MS + 1) * 1000);
+        loopOnce();
+    }
+
+    static uint64_t cameraReceivedUs(const char* response) {
+        const char* pos = strstr(response, "X-Emu-Received-Us:");
+        if (pos == nullptr) {
+            return 0;
+        }
+        return strtoull(pos + strlen("X-Emu-Received-Us:"), nullptr, 10);
+    }
+
+    void sample(ActionResult& result, Gesture gesture, uint pin, bool record, uint pin2 = NO_PIN) {
+        int id = camera.httpClient.cnter;
+
+        host_network_tcp_stats_t tcp0;
+        host_network_get_tcp_stats(&tcp0);
+
+        result.gestureDelayMs = perform(gesture, pin, pin2);
+        uint64_t t0 = realUs();
+
+        // a preset recall sends several writes, the press is done with the last
+        std::vector<HttpRequest*> reqs;
+        uint64_t deadline = t0 + timeoutMs * 1000;
+        while (reqs.empty() && realUs() < deadline) {
+            loopOnce();
+            reqs = findDone(id);
+        }
+        uint64_t t1 = realUs();
+
+        host_network_tcp_stats_t tcp1;
+        host_network_get_tcp_stats(&tcp1);
+
+        finish(pin, pin2);
+
+        uint64_t cam = 0;
+        for (HttpRequest* req : reqs) {
+            uint64_t received = cameraReceivedUs(req->responseString.c_str());
+            if (received == 0) {
+                cam = 0;
+                break;
+            }
+            cam = std::max(cam, received);
+        }
+        if (cam == 0) {
+            if (record) {
+                result.failed++;
+            }
+        } else if (record) {
+            result.camera.values.push_back(cam > t0 ? cam - t0 : 0);
+            result.complete.values.push_back(t1 - t0);
+            result.segments.values.push_back(tcp1.segments - tcp0.segments);
+            result.dataSegments.values.push_back(tcp1.data_segments - tcp0.data_segments);
+            result.requests.values.push_back(reqs.size());
+        }
+
+        releaseDoneRequests();
+        idle(5);
+    }
+
+    std::string burst(int presses) {
+        int firstId = camera.httpClient.cnter;
+        uint64_t t0 = realUs();
+
+        for (int i = 0; i < presses; i++) {
+            host_gpio_set(BUTTON_FOCUS2, false);
+            loopOnce();
+            finish(BUTTON_FOCUS2);
+        }
+
+        int completed = 0;
+        int failed = 0;
+        uint64_t deadline = realUs() + timeoutMs * 1000;
+        while (completed + failed < presses && realUs() < deadline) {
+            loopOnce();
+            for (HttpRequest* req : camera.httpClient.doneRequests) {
+                if (req->id < firstId) {
+                    continue;
+                }
+                if (cameraReceivedUs(req->responseString.c_str()) != 0) {
+                    completed++;
+                } else {
+                    failed++;
+                }
+            }
+            releaseDoneRequests();
+        }
+        uint64_t elapsed = realUs() - t0;
+
+        char buff[256];
+        snprintf(buff, sizeof(buff),
+            "{\"presses\": %d, \"completed\": %d, \"failed\": %d, \"elapsed_us\": %llu, \"requests_per_sec\": %.1f}",
+            presses, completed, failed, (unsigned long long)elapsed, elapsed ? completed * 1e6 / elapsed : 0.0);
+        return buff;
+    }
+};
+
+int main(int argc, char** argv) {
+    int samples = 50;
+    int burstPresses = 20;
+    const char* outPath = "bench_latency.json";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            burstPresses = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-prewarm") == 0) {
+            HttpClient::prewarmMaxAgeMs = 0;
+        } else {
+            fprintf(stderr, "usage: %s [--samples N] [--burst N] [--out FILE] [--no-prewarm]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    serial_init();
+
+    Camera camera;
+    // the bench reads the responses itself
+    camera.httpClient.keepDone = true;
+
+    if (!usb_network_init(&ownip, &netmask, &gateway, true)) {
+        fprintf(stderr, "failed to start host network\n");
+        return 1;
+    }
+
+    dhcp_server_t dhcp_server;
+    dhcp_server_init(&dhcp_server, (ip_addr_t *)&ownip, (ip_addr_t *)&netmask, false);
+
+    Buttons buttons;
+    Bench bench(camera, buttons);
+
+    ActionResult results[] = {
+        {"record", 0},
+        {"autofocus", 0},
+        {"wb_cycle", 0},
+        {"native_gain", 0},
+        {"preset", 0},
+    };
+
+    // first request pays for arp, keep it out of the numbers
+    bench.sample(results[1], Bench::SHORT_PRESS, BUTTON_FOCUS, false);
+
+    for (int i = 0; i < samples; i++) {
+        bench.sample(results[0], Bench::PRESS, BUTTON_RECORD, true);
+        bench.sample(results[1], Bench::SHORT_PRESS, BUTTON_FOCUS, true);
+        bench.sample(results[2], Bench::SHORT_PRESS, BUTTON_AUX, true);
+        bench.sample(results[3], Bench::LONG_PRESS, BUTTON_FOCUS, true);
+        bench.sample(results[4], Bench::CHORD, BUTTON_AUX, true, BUTTON_FOCUS);
+    }
+
+    bench.idle(100);
+    std::string burst = bench.burst(burstPresses);
+
+    FILE* out = fopen(outPath, "w");
+    if (!out) {
+        fprintf(stderr, "cannot write %s\n", outPath);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"bench\": \"press_to_camera\",\n  \"samples\": %d,\n  \"prewarm_ms\": %d,\n  \"actions\": {\n", samples,
+        HttpClient::prewarmMaxAgeMs);
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        ActionResult& r = results[i];
+        fprintf(out, "    \"%s\": {\"n\": %zu, \"failed\": %d, \"gesture_delay_ms\": %d,\n", r.name.c_str(), r.complete.values.size(),
+            r.failed, r.gestureDelayMs);
+        fprintf(out, "      \"camera_us\": %s,\n      \"complete_us\": %s,\n", r.camera.json().c_str(), r.complete.json().c_str());
+        fprintf(out, "      \"tcp_segments\": %s,\n      \"data_segments\": %s,\n      \"requests\": %s}%s\n",
+            r.segments.json().c_str(), r.dataSegments.json().c_str(), r.requests.json().c_str(), i + 1 < sizeof(results) / sizeof(results[0]) ? "," : "");
+        fprintf(stderr, "%-12s camera p50 %6llu us p99 %6llu us | complete p50 %6llu us p99 %6llu us | segments %llu (%llu data) | failed %d\n",
+            r.name.c_str(), (unsigned long long)r.camera.percentile(50), (unsigned long long)r.camera.percentile(99),
+            (unsigned long long)r.complete.percentile(50), (unsigned long long)r.complete.percentile(99),
+            (unsigned long long)r.segments.percentile(50), (unsigned long long)r.dataSegments.percentile(100), r.failed);
+    }
+    fprintf(out, "  },\n  \"burst\": %s\n}\n", burst.c_str());
+    fclose(out);
+
+    fprintf(stderr, "burst        %s\n", burst.c_str());
+
+    // firmware side view of the same run, goes to the log with the other output
+    camera.httpClient.stats.dump(Camera::actionNames, Camera::NUM_ACTION_TYPES);
+
+    dhcp_server_deinit(&dhcp_server);
+    usb_network_deinit();
+
+    return 0;
+}
@@ -0,0 +1,877 @@
+// Blackmagic camera control REST API emulator
+//
+// Small single threaded host program that answers the subset of
+// /control/api/v1 used by the firmware. Property state is kept as flat json
+// objects per path, so PUT {"gain": 18} to video/gain is returned by the next
+// GET. Latency, jitter, dropped connections and keep-alive handling are
+// configurable so the controller can be benchmarked against a "bad" camera.
+//
+// Changes are pushed to WebSocket clients on /control/api/v1/event/websocket
+// in the same format the camera uses (propertyValueChanged events).
+//
+// run with the tap from host/setup_tap.sh to answer at 10.0.7.16:80:
+//   sudo ./camera_emu --bind 10.0.7.16 --latency-ms 20 --jitter-ms 10
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/* utils ======================================== */
+
+static uint64_t nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    if (b == std::string::npos) {
+        return "";
+    }
+    return s.substr(b, e - b + 1);
+}
+
+/** sha1 + base64, only needed for the websocket handshake */
+class Sha1 {
+public:
+    static std::string digest(const std::string& msg) {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+        std::string m = msg;
+        uint64_t bitLen = (uint64_t)msg.size() * 8;
+        m.push_back((char)0x80);
+        while (m.size() % 64 != 56) {
+            m.push_back(0);
+        }
+        for (int i = 7; i >= 0; i--) {
+            m.push_back((char)(bitLen >> (i * 8)));
+        }
+
+        for (size_t chunk = 0; chunk < m.size(); chunk += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++) {
+                const unsigned char* p = (const unsigned char*)&m[chunk + i * 4];
+                w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+            }
+            for (int i = 16; i < 80; i++) {
+                w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; i++) {
+                uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t t = rol(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rol(b, 30);
+                b = a;
+                a = t;
+            }
+
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::string out;
+        for (int i = 0; i < 5; i++) {
+            for (int j = 3; j >= 0; j--) {
+                out.push_back((char)(h[i] >> (j * 8)));
+            }
+        }
+        return out;
+    }
+
+    static std::string base64(const std::string& in) {
+        static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        size_t i = 0;
+        while (i + 2 < in.size()) {
+            uint32_t v = (unsigned char)in[i] << 16 | (unsigned char)in[i + 1] << 8 | (unsigned char)in[i + 2];
+            out += tbl[(v >> 18) & 63];
+            out += tbl[(v >> 12) & 63];
+            out += tbl[(v >> 6) & 63];
+            out += tbl[v & 63];
+            i += 3;
+        }
+        if (i + 1 == in.size()) {
+            uint32_t v = (unsigned char)in[i] << 16;
+            out += tbl[(v >> 18) & 63];
+            out += tbl[(v >> 12) & 63];
+            out += "==";
+        } else if (i + 2 == in.size()) {
+            uint32_t v = (unsigned char)in[i] << 16 | (unsigned char)in[i + 1] << 8;
+            out += tbl[(v >> 18) & 63];
+            out += tbl[(v >> 12) & 63];
+            out += tbl[(v >> 6) & 63];
+            out += '=';
+        }
+        return out;
+    }
+
+private:
+    static uint32_t rol(uint32_t v, int n) {
+        return (v << n) | (v >> (32 - n));
+    }
+};
+
+/* options ====================================== */
+
+class Options {
+public:
+    std::string bindAddr = "10.0.7.16";
+    int port = 80;
+
+    int latencyMs = 0;     // fixed delay before each response
+    int jitterMs = 0;      // plus uniform [0, jitter)
+    double dropRate = 0.0; // probability a request gets its connection reset instead of a reply
+
+    enum KeepAlive {
+        KEEPALIVE_HONOR, // follow the request's Connection header (HTTP/1.1 default keep-alive)
+        KEEPALIVE_NEVER, // always close after the response
+        KEEPALIVE_ALWAYS // ignore "Connection: close"
+    } keepAlive = KEEPALIVE_HONOR;
+    int idleTimeoutMs = 5000; // keep-alive connections idle longer than this are closed
+
+    bool websocket = true;
+    bool verbose = false;
+    unsigned seed = 1;
+
+    static void usage(const char* prog) {
+        printf("usage: %s [options]\n"
+               "  --bind ADDR            listen address (default 10.0.7.16)\n"
+               "  --port N               listen port (default 80)\n"
+               "  --latency-ms N         delay before each response\n"
+               "  --jitter-ms N          extra random delay [0, N)\n"
+               "  --drop-rate P          reset the connection instead of answering with probability P\n"
+               "  --keepalive MODE       honor | never | always (default honor)\n"
+               "  --idle-timeout-ms N    close idle keep-alive connections after N ms (default 5000)\n"
+               "  --no-websocket         refuse websocket upgrades\n"
+               "  --seed N               random seed for jitter/drops\n"
+               "  -v                     log every request\n",
+            prog);
+    }
+
+    bool parse(int argc, char** argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            bool hasNext = i + 1 < argc;
+
+            if (a == "--bind" && hasNext) {
+                bindAddr = argv[++i];
+            } else if (a == "--port" && hasNext) {
+                port = atoi(argv[++i]);
+            } else if (a == "--latency-ms" && hasNext) {
+                latencyMs = atoi(argv[++i]);
+            } else if (a == "--jitter-ms" && hasNext) {
+                jitterMs = atoi(argv[++i]);
+            } else if (a == "--drop-rate" && hasNext) {
+                dropRate = atof(argv[++i]);
+            } else if (a == "--keepalive" && hasNext) {
+                std::string m = argv[++i];
+                if (m == "honor") {
+                    keepAlive = KEEPALIVE_HONOR;
+                } else if (m == "never") {
+                    keepAlive = KEEPALIVE_NEVER;
+                } else if (m == "always") {
+                    keepAlive = KEEPALIVE_ALWAYS;
+                } else {
+                    return false;
+                }
+            } else if (a == "--idle-timeout-ms" && hasNext) {
+                idleTimeoutMs = atoi(argv[++i]);
+            } else if (a == "--no-websocket") {
+                websocket = false;
+            } else if (a == "--seed" && hasNext) {
+                seed = (unsigned)atoi(argv[++i]);
+            } else if (a == "-v") {
+                verbose = true;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/* camera state ================================= */
+
+/** flat json object, values kept as raw json text */
+typedef std::map<std::string, std::string> JsonObject;
+
+class CameraState {
+public:
+    // path relative to /control/api/v1, e.g. "video/gain"
+    std::map<std::string, JsonObject> properties;
+
+    CameraState() {
+        properties["video/gain"] = {{"gain", "0"}};
+        properties["video/iso"] = {{"iso", "400"}};
+        properties["video/whiteBalance"] = {{"whiteBalance", "5600"}};
+        properties["video/whiteBalanceTint"] = {{"whiteBalanceTint", "0"}};
+        properties["video/shutter"] = {{"shutterSpeed", "50"}};
+        properties["video/ndFilter"] = {{"stop", "0"}};
+        properties["lens/iris"] = {{"apertureStop", "2.8"}, {"normalised", "0.2"}};
+        properties["lens/focus"] = {{"normalised", "0.5"}};
+        properties["transports/0/record"] = {{"recording", "false"}};
+        properties["monitoring/display/cleanFeed"] = {{"enabled", "false"}};
+    }
+
+    static JsonObject parse(const std::string& body) {
+        JsonObject obj;
+        size_t i = body.find('{');
+        if (i == std::string::npos) {
+            return obj;
+        }
+        i++;
+
+        while (i < body.size()) {
+            size_t ks = body.find('"', i);
+            if (ks == std::string::npos) {
+                break;
+            }
+            size_t ke = body.find('"', ks + 1);
+            if (ke == std::string::npos) {
+                break;
+            }
+            size_t colon = body.find(':', ke);
+            if (colon == std::string::npos) {
+                break;
+            }
+
+            // value runs to the next top level ',' or '}'
+            size_t v = colon + 1;
+            int depth = 0;
+            bool inString = false;
+            for (; v < body.size(); v++) {
+                char c = body[v];
+                if (inString) {
+                    if (c == '\\') {
+                        v++;
+                    } else if (c == '"') {
+                        inString = false;
+                    }
+                } else if (c == '"') {
+                    inString = true;
+                } else if (c == '{' || c == '[') {
+                    depth++;
+                } else if ((c == '}' || c == ']') && depth > 0) {
+                    depth--;
+                } else if ((c == ',' || c == '}') && depth == 0) {
+                    break;
+                }
+            }
+
+            obj[body.substr(ks + 1, ke - ks - 1)] = trim(body.substr(colon + 1, v - colon - 1));
+            i = v + 1;
+        }
+
+        return obj;
+    }
+
+    static std::string serialize(const JsonObject& obj) {
+        std::string out = "{";
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            if (it != obj.begin()) {
+                out += ",";
+            }
+            out += "\"" + it->first + "\":" + it->second;
+        }
+        return out + "}";
+    }
+
+    bool has(const std::string& path) const {
+        return properties.find(path) != properties.end();
+    }
+
+    // merge keys of body into path, returns true if anything changed
+    bool merge(const std::string& path, const JsonObject& body) {
+        JsonObject& cur = properties[path];
+        bool changed = false;
+        for (auto& kv : body) {
+            auto it = cur.find(kv.first);
+            if (it == cur.end() || it->second != kv.second) {
+                cur[kv.first] = kv.second;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+};
+
+/* server ======================================= */
+
+class Connection {
+public:
+    int fd;
+    std::string in;
+    bool websocket = false;
+    bool closeAfterSend = false;
+    uint64_t lastActivityUs;
+    uint64_t lastDueUs = 0; // responses on one connection leave in order
+    int requests = 0;
+
+    Connection(int _fd) {
+        fd = _fd;
+        lastActivityUs = nowUs();
+    }
+};
+
+class PendingResponse {
+public:
+    int fd;
+    uint64_t dueUs;
+    std::string data;
+    bool close;
+    bool reset;
+};
+
+class Server {
+public:
+    Options opt;
+    CameraState state;
+    std::map<int, Connection*> conns;
+    std::vector<PendingResponse> pending;
+    std::mt19937 rng;
+    int listenFd = -1;
+
+    struct {
+        uint64_t connections = 0;
+        uint64_t requests = 0;
+        uint64_t puts = 0;
+        uint64_t gets = 0;
+        uint64_t drops = 0;
+        uint64_t notFound = 0;
+        uint64_t wsEvents = 0;
+    } stats;
+
+    Server(const Options& _opt) : opt(_opt), rng(_opt.seed) {}
+
+    bool listen() {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listenFd < 0) {
+            perror("socket");
+            return false;
+        }
+
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(opt.port);
+        if (inet_pton(AF_INET, opt.bindAddr.c_str(), &addr.sin_addr) != 1) {
+            printf("bad bind address %s\n", opt.bindAddr.c_str());
+            return false;
+        }
+
+        if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("bind");
+            return false;
+        }
+
+        if (::listen(listenFd, 16) < 0) {
+            perror("listen");
+            return false;
+        }
+
+        printf("camera_emu: listening on %s:%d\n", opt.bindAddr.c_str(), opt.port);
+        return true;
+    }
+
+    void accept() {
+        for (;;) {
+            int fd = ::accept4(listenFd, NULL, NULL, SOCK_NONBLOCK);
+            if (fd < 0) {
+                return;
+            }
+
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            conns[fd] = new Connection(fd);
+            stats.connections++;
+        }
+    }
+
+    void closeConn(int fd, bool reset) {
+        auto it = conns.find(fd);
+        if (it == conns.end()) {
+            return;
+        }
+
+        if (reset) {
+            struct linger lg = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        }
+
+        ::close(fd);
+        delete it->second;
+        conns.erase(it);
+
+        // drop anything still queued for this fd, it may get reused
+        for (auto p = pending.begin(); p != pending.end();) {
+            if (p->fd == fd) {
+                p = pending.erase(p);
+            } else {
+                ++p;
+            }
+        }
+    }
+
+    uint64_t responseDelayUs() {
+        uint64_t d = (uint64_t)opt.latencyMs * 1000;
+        if (opt.jitterMs > 0) {
+            d += std::uniform_int_distribution<uint64_t>(0, (uint64_t)opt.jitterMs * 1000 - 1)(rng);
+        }
+        return d;
+    }
+
+    void queue(Connection* c, const std::string& data, bool close, bool reset) {
+        uint64_t due = nowUs() + responseDelayUs();
+        if (due < c->lastDueUs) {
+            due = c->lastDueUs;
+        }
+        c->lastDueUs = due;
+        pending.push_back({c->fd, due, data, close, reset});
+    }
+
+    // CLOCK_MONOTONIC time the request being answered was parsed, echoed as
+    // X-Emu-Received-Us so host benchmarks can split client and camera time
+    uint64_t receivedUs = 0;
+
+    std::string response(int code, const char* reason, const std::string& body, bool keepAlive) {
+        std::string r = "HTTP/1.1 " + std::to_string(code) + " " + reason + "\r\n";
+        r += "Server: camera_emu\r\n";
+        r += "X-Emu-Received-Us: " + std::to_string(receivedUs) + "\r\n";
+        if (code != 204) {
+            r += "Content-Type: application/json\r\n";
+            r += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        r += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        r += "\r\n";
+        return r + body;
+    }
+
+    /* websocket ================================ */
+
+    static std::string wsFrame(const std::string& payload) {
+        std::string f;
+        f.push_back((char)0x81); // FIN + text
+        if (payload.size() < 126) {
+            f.push_back((char)payload.size());
+        } else {
+            f.push_back(126);
+            f.push_back((char)(payload.size() >> 8));
+            f.push_back((char)payload.size());
+        }
+        return f + payload;
+    }
+
+    void wsBroadcast(const std::string& path, const JsonObject& value) {
+        std::string msg = "{\"type\":\"event\",\"data\":{\"action\":\"propertyValueChanged\",\"property\":\"/" + path +
+                          "\",\"value\":" + CameraState::serialize(value) + "}}";
+
+        for (auto& kv : conns) {
+            if (kv.second->websocket) {
+                queue(kv.second, wsFrame(msg), false, false);
+                stats.wsEvents++;
+            }
+        }
+    }
+
+    void wsHandleInput(Connection* c) {
+        // only parse enough to answer requests and notice close frames
+        while (c->in.size() >= 2) {
+            const unsigned char* b = (const unsigned char*)c->in.data();
+            int opcode = b[0] & 0x0f;
+            bool masked = b[1] & 0x80;
+            uint64_t len = b[1] & 0x7f;
+            size_t hdr = 2;
+            if (len == 126) {
+                if (c->in.size() < 4) {
+                    return;
+                }
+                len = (uint64_t)b[2] << 8 | b[3];
+                hdr = 4;
+            } else if (len == 127) {
+                // no client of ours sends this
+                closeConn(c->fd, true);
+                return;
+            }
+            if (masked) {
+                hdr += 4;
+            }
+            if (c->in.size() < hdr + len) {
+                return;
+            }
+
+            std::string payload = c->in.substr(hdr, len);
+            if (masked) {
+                for (size_t i = 0; i < payload.size(); i++) {
+                    payload[i] ^= b[hdr - 4 + (i % 4)];
+                }
+            }
+            c->in.erase(0, hdr + len);
+
+            if (opcode == 0x8) {
+                closeConn(c->fd, false);
+                return;
+            }
+
+            if (opcode == 0x1 && payload.find("\"subscribe\"") != std::string::npos) {
+                std::string ack = "{\"type\":\"response\",\"data\":{\"action\":\"subscribe\",\"success\":true}}";
+                queue(c, wsFrame(ack), false, false);
+            }
+        }
+    }
+
+    /* http ===================================== */
+
+    void handleRequest(Connection* c, const std::string& method, const std::string& target, const std::map<std::string, std::string>& headers,
+        const std::string& body) {
+        receivedUs = nowUs();
+        stats.requests++;
+        c->requests++;
+
+        auto header = [&](const char* name) -> std::string {
+            auto it = headers.find(name);
+            return it == headers.end() ? "" : it->second;
+        };
+
+        bool keepAlive = strcasecmp(header("connection").c_str(), "close") != 0;
+        if (opt.keepAlive == Options::KEEPALIVE_NEVER) {
+            keepAlive = false;
+        } else if (opt.keepAlive == Options::KEEPALIVE_ALWAYS) {
+            keepAlive = true;
+        }
+
+        if (opt.verbose) {
+            printf("#%d %s %s %s\n", c->fd, method.c_str(), target.c_str(), body.c_str());
+        }
+
+        if (opt.dropRate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < opt.dropRate) {
+            stats.drops++;
+            queue(c, "", true, true);
+            return;
+        }
+
+        static const std::string prefix = "/control/api/v1/";
+        std::string path = target.compare(0, prefix.size(), prefix) == 0 ? target.substr(prefix.size()) : "";
+
+        if (path == "event/websocket" && strcasecmp(header("upgrade").c_str(), "websocket") == 0) {
+            if (!opt.websocket) {
+                queue(c, response(404, "Not Found", "{}", false), true, false);
+                return;
+            }
+
+            std::string accept = Sha1::base64(Sha1::digest(header("sec-websocket-key") + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+            std::string r = "HTTP/1.1 101 Switching Protocols\r\n"
+                            "Upgrade: websocket\r\n"
+                            "Connection: Upgrade\r\n"
+                            "Sec-WebSocket-Accept: " +
+                            accept + "\r\n\r\n";
+            c->websocket = true;
+            queue(c, r, false, false);
+            return;
+        }
+
+        if (method == "GET") {
+            stats.gets++;
+            if (!state.has(path)) {
+                stats.notFound++;
+                queue(c, response(404, "Not Found", "{}", keepAlive), !keepAlive, false);
+                return;
+            }
+            queue(c, response(200, "OK", CameraState::serialize(state.properties[path]), keepAlive), !keepAlive, false);
+            return;
+        }
+
+        if (method == "PUT") {
+            stats.puts++;
+
+            if (path == "lens/focus/doAutoFocus") {
+                state.merge("lens/focus", {{"normalised", "0.42"}});
+                wsBroadcast("lens/focus", state.properties["lens/focus"]);
+            } else if (path == "video/whiteBalance/doAuto") {
+                if (state.merge("video/whiteBalance", {{"whiteBalance", "5200"}})) {
+                    wsBroadcast("video/whiteBalance", state.properties["video/whiteBalance"]);
+                }
+            } else if (path == "transports/0/stop") {
+                if (state.merge("transports/0/record", {{"recording", "false"}})) {
+                    wsBroadcast("transports/0/record", state.properties["transports/0/record"]);
+                }
+            } else if (state.has(path)) {
+                JsonObject value = CameraState::parse(body);
+                if (value.empty() && path != "transports/0/record") {
+                    queue(c, response(400, "Bad Request", "{}", keepAlive), !keepAlive, false);
+                    return;
+                }
+                if (path == "transports/0/record" && value.empty()) {
+                    value["recording"] = "true";
+                }
+                if (state.merge(path, value)) {
+                    wsBroadcast(path, state.properties[path]);
+                }
+            } else {
+                stats.notFound++;
+                queue(c, response(404, "Not Found", "{}", keepAlive), !keepAlive, false);
+                return;
+            }
+
+            queue(c, response(204, "No Content", "", keepAlive), !keepAlive, false);
+            return;
+        }
+
+        queue(c, response(405, "Method Not Allowed", "{}", keepAlive), !keepAlive, false);
+    }
+
+    void handleInput(Connection* c) {
+        while (!c->websocket) {
+            // tolerate stray CRLF between requests (RFC 7230 3.5)
+            size_t start = c->in.find_first_not_of("\r\n");
+            if (start == std::string::npos) {
+                c->in.clear();
+                return;
+            }
+            if (start > 0) {
+                c->in.erase(0, start);
+            }
+
+            size_t headerEnd = c->in.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) {
+                return;
+            }
+
+            std::string head = c->in.substr(0, headerEnd);
+            size_t lineEnd = head.find("\r\n");
+            std::string requestLine = head.substr(0, lineEnd);
+
+            std::map<std::string, std::string> headers;
+            size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+            while (pos < head.size()) {
+                size_t e = head.find("\r\n", pos);
+                if (e == std::string::npos) {
+                    e = head.size();
+                }
+                std::string line = head.substr(pos, e - pos);
+                size_t colon = line.find(':');
+                if (colon != std::string::npos) {
+                    std::string name = line.substr(0, colon);
+                    for (auto& ch : name) {
+                        ch = (char)tolower((unsigned char)ch);
+                    }
+                    headers[name] = trim(line.substr(colon + 1));
+                }
+                pos = e + 2;
+            }
+
+            size_t contentLength = 0;
+            if (headers.count("content-length")) {
+                contentLength = (size_t)atol(headers["content-length"].c_str());
+            }
+            if (c->in.size() < headerEnd + 4 + contentLength) {
+                return;
+            }
+
+            std::string body = c->in.substr(headerEnd + 4, contentLength);
+            c->in.erase(0, headerEnd + 4 + contentLength);
+
+            size_t sp1 = requestLine.find(' ');
+            size_t sp2 = requestLine.find(' ', sp1 + 1);
+            if (sp1 == std::string::npos || sp2 == std::string::npos) {
+                closeConn(c->fd, true);
+                return;
+            }
+
+            handleRequest(c, requestLine.substr(0, sp1), requestLine.substr(sp1 + 1, sp2 - sp1 - 1), headers, body);
+        }
+
+        wsHandleInput(c);
+    }
+
+    void read(Connection* c) {
+        char buf[2048];
+        for (;;) {
+            ssize_t n = ::recv(c->fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c->in.append(buf, n);
+                c->lastActivityUs = nowUs();
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                closeConn(c->fd, false);
+                return;
+            }
+            break;
+        }
+
+        handleInput(c);
+    }
+
+    void flushDue() {
+        uint64_t now = nowUs();
+
+        for (size_t i = 0; i < pending.size();) {
+            if (pending[i].dueUs > now) {
+                i++;
+                continue;
+            }
+
+            PendingResponse p = pending[i];
+            pending.erase(pending.begin() + i);
+
+            if (conns.find(p.fd) == conns.end()) {
+                continue;
+            }
+
+            if (!p.data.empty()) {
+                // responses are small, a short write means the client is gone
+                ssize_t n = ::send(p.fd, p.data.data(), p.data.size(), MSG_NOSIGNAL);
+                if (n != (ssize_t)p.data.size()) {
+                    closeConn(p.fd, true);
+                    continue;
+                }
+                conns[p.fd]->lastActivityUs = now;
+            }
+
+            if (p.close) {
+                closeConn(p.fd, p.reset);
+            }
+
+            // closeConn() may have removed entries, restart the scan
+            i = 0;
+        }
+    }
+
+    void closeIdle() {
+        uint64_t now = nowUs();
+        std::vector<int> idle;
+        for (auto& kv : conns) {
+            Connection* c = kv.second;
+            if (!c->websocket && now - c->lastActivityUs > (uint64_t)opt.idleTimeoutMs * 1000) {
+                bool waiting = false;
+                for (auto& p : pending) {
+                    waiting |= p.fd == c->fd;
+                }
+                if (!waiting) {
+                    idle.push_back(c->fd);
+                }
+            }
+        }
+        for (int fd : idle) {
+            closeConn(fd, false);
+        }
+    }
+
+    int pollTimeoutMs() {
+        uint64_t now = nowUs();
+        uint64_t next = now + 100000;
+        for (auto& p : pending) {
+            if (p.dueUs < next) {
+                next = p.dueUs;
+            }
+        }
+        return next <= now ? 0 : (int)((next - now + 999) / 1000);
+    }
+
+    void run(volatile sig_atomic_t& stop) {
+        while (!stop) {
+            std::vector<struct pollfd> pfds;
+            pfds.push_back({listenFd, POLLIN, 0});
+            for (auto& kv : conns) {
+                pfds.push_back({kv.first, POLLIN, 0});
+            }
+
+            int n = poll(pfds.data(), pfds.size(), pollTimeoutMs());
+            if (n < 0 && errno != EINTR) {
+                perror("poll");
+                return;
+            }
+
+            for (auto& pfd : pfds) {
+                if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                if (pfd.fd == listenFd) {
+                    accept();
+                } else if (conns.count(pfd.fd)) {
+                    read(conns[pfd.fd]);
+                }
+            }
+
+            flushDue();
+            closeIdle();
+        }
+    }
+
+    void printStats() {
+        printf("camera_emu: connections=%llu requests=%llu gets=%llu puts=%llu drops=%llu notFound=%llu wsEvents=%llu\n",
+            (unsigned long long)stats.connections, (unsigned long long)stats.requests, (unsigned long long)stats.gets,
+            (unsigned long long)stats.puts, (unsigned long long)stats.drops, (unsigned long long)stats.notFound,
+            (unsigned long long)stats.wsEvents);
+    }
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!opt.parse(argc, argv)) {
+        Options::usage(argv[0]);
+        return 1;
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    Server server(opt);
+    if (!server.listen()) {
+        return 1;
+    }
+
+    server.run(stopRequested);
+    server.printStats();
+
+    return 0;
+}
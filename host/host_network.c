@@ -0,0 +1,250 @@
+// simulated usb ethernet for the host build
+//
+// implements the usb_network.h api on top of a linux TAP device instead of
+// TinyUSB. every ethernet frame lwIP sends goes to the tap fd and every frame
+// the kernel writes to the tap is fed to lwIP, so the kernel side of the tap
+// plays the role of the camera's usb network interface.
+//
+// the tap name is taken from BMMSC_TAP (default "bmmsc0"). create it once with
+// host/setup_tap.sh, which also gives the kernel side 10.0.7.16 - the address
+// the firmware expects the camera to get from the dhcp server.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <lwip/etharp.h>
+#include <lwip/init.h>
+#include <lwip/ip.h>
+#include <lwip/opt.h>
+#include <lwip/pbuf.h>
+#include <lwip/stats.h>
+#include <lwip/timeouts.h>
+#include <netif/ethernet.h>
+#include <pico/time.h>
+#include <pico/unique_id.h>
+
+#include "host_network.h"
+#include "usb_console.h"
+#include "usb_network.h"
+
+#define HOST_NET_MTU 1500
+#define HOST_NET_FRAME_MAX (HOST_NET_MTU + 14)
+
+// kept under the same name as the usb build so code printing the mac works unchanged
+uint8_t tud_network_mac_address[6];
+
+static struct netif netif_tap;
+static bool netif_added = false;
+
+// the tap is "enumerated" once it is open
+static uint64_t up_us = 0;
+static int tap_fd = -1;
+
+static uint8_t frame_buf[HOST_NET_FRAME_MAX];
+
+static host_network_tcp_stats_t tcp_stats;
+
+static int tap_open(const char *name) {
+  int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (fd < 0) {
+    printf("host_network: open /dev/net/tun failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+
+  if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+    printf("host_network: TUNSETIFF %s failed: %s\n", name, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+// ethernet / ipv4 / tcp headers of an outgoing frame, to count segments and
+// the ones carrying data
+static void count_tcp(const uint8_t *frame, uint16_t len) {
+  if (len < 14 + 20 || frame[12] != 0x08 || frame[13] != 0x00 || frame[14 + 9] != IP_PROTO_TCP) {
+    return;
+  }
+  const uint8_t *ip = frame + 14;
+  int ip_hlen = (ip[0] & 0x0f) * 4;
+  int ip_len = ip[2] << 8 | ip[3];
+  if (len < 14 + ip_hlen + 20) {
+    return;
+  }
+  int tcp_hlen = (ip[ip_hlen + 12] >> 4) * 4;
+  int payload = ip_len - ip_hlen - tcp_hlen;
+
+  tcp_stats.segments++;
+  if (payload > 0) {
+    tcp_stats.data_segments++;
+    tcp_stats.data_bytes += payload;
+  }
+}
+
+void host_network_get_tcp_stats(host_network_tcp_stats_t *stats) {
+  *stats = tcp_stats;
+}
+
+static err_t tap_output(__unused struct netif *netif, struct pbuf *p) {
+  if (tap_fd < 0) {
+    return ERR_USE;
+  }
+
+  // LWIP_NETIF_TX_SINGLE_PBUF is set, but copy anyway to stay correct for chains
+  uint16_t len = pbuf_copy_partial(p, frame_buf, sizeof(frame_buf), 0);
+  if (write(tap_fd, frame_buf, len) != len) {
+    LINK_STATS_INC(link.err);
+    return ERR_IF;
+  }
+  count_tcp(frame_buf, len);
+
+  LINK_STATS_INC(link.xmit);
+  return ERR_OK;
+}
+
+static err_t netif_init_cb(struct netif *netif) {
+  LWIP_ASSERT("netif != NULL", (netif != NULL));
+  netif->mtu = HOST_NET_MTU;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_IGMP | NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
+  netif->state = NULL;
+  netif->name[0] = 'E';
+  netif->name[1] = 'X';
+  netif->linkoutput = tap_output;
+#if LWIP_IPV4
+  netif->output = etharp_output;
+#endif
+  return ERR_OK;
+}
+
+static void service_traffic(int timeout_ms) {
+  struct pollfd pfd = {.fd = tap_fd, .events = POLLIN};
+
+  // the wait replaces the busy loop of the device build; a frame arriving
+  // wakes it immediately so it adds no latency
+  if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+    for (;;) {
+      ssize_t size = read(tap_fd, frame_buf, sizeof(frame_buf));
+      if (size <= 0) {
+        break;
+      }
+
+      struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)size, PBUF_POOL);
+      if (p == NULL) {
+        LINK_STATS_INC(link.memerr);
+        LINK_STATS_INC(link.drop);
+        break;
+      }
+
+      LINK_STATS_INC(link.recv);
+      pbuf_take(p, frame_buf, (u16_t)size);
+      if (netif_tap.input(p, &netif_tap) != ERR_OK) {
+        pbuf_free(p); // only free on error
+      }
+    }
+  }
+}
+
+void usb_network_update() {
+  usb_network_update_usb();
+  usb_network_update_lwip();
+}
+
+// the tap wait and frame input stand in for tud_task()
+void usb_network_update_usb() {
+  service_traffic(1);
+}
+
+void usb_network_update_lwip() {
+  sys_check_timeouts();
+}
+
+bool usb_network_is_up() {
+  return tap_fd >= 0;
+}
+
+uint64_t usb_network_up_us() {
+  return up_us;
+}
+
+bool usb_network_init(const ip4_addr_t *ownip, const ip4_addr_t *netmask, const ip4_addr_t *gateway, bool init_lwip) {
+  const char *tap_name = getenv("BMMSC_TAP");
+  if (tap_name == NULL) {
+    tap_name = "bmmsc0";
+  }
+
+  tap_fd = tap_open(tap_name);
+  if (tap_fd < 0) {
+    return false;
+  }
+  up_us = time_us_64();
+
+  if (init_lwip) {
+    lwip_init();
+  }
+
+  // same derivation as the usb build so leases and mdns names look alike
+  pico_unique_board_id_t board_id;
+  pico_get_unique_board_id(&board_id);
+  memcpy(tud_network_mac_address, &board_id.id[2], 6);
+  tud_network_mac_address[0] &= (uint8_t)~0x1; // unicast
+  tud_network_mac_address[0] |= 0x2; // locally administered
+
+  netif_tap.hwaddr_len = sizeof(tud_network_mac_address);
+  memcpy(netif_tap.hwaddr, tud_network_mac_address, sizeof(tud_network_mac_address));
+  netif_tap.hwaddr[5] ^= 0x01;
+
+  printf("host_network: %s using MAC: %02X%02X%02X%02X%02X%02X\n", tap_name, netif_tap.hwaddr[0], netif_tap.hwaddr[1], netif_tap.hwaddr[2],
+    netif_tap.hwaddr[3], netif_tap.hwaddr[4], netif_tap.hwaddr[5]);
+
+  if (netif_add(&netif_tap, ownip, netmask, gateway, NULL, netif_init_cb, ethernet_input) == NULL) {
+    printf("host_network: error adding netif\n");
+    return false;
+  }
+
+  netif_set_default(&netif_tap);
+  netif_set_up(&netif_tap);
+  netif_set_link_up(&netif_tap);
+  netif_added = true;
+
+  return true;
+}
+
+void usb_network_deinit() {
+  if (netif_added) {
+    netif_remove(&netif_tap);
+    netif_added = false;
+  }
+
+  if (tap_fd >= 0) {
+    close(tap_fd);
+    tap_fd = -1;
+  }
+}
+
+// there is no usb device on the host, stdout already is the console
+
+void usb_console_init(void) {}
+
+bool usb_console_connected(void) {
+  return false;
+}
+
+void usb_console_get_stats(usb_console_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
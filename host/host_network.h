@@ -0,0 +1,25 @@
+// host build only: what the simulated usb link saw, for bench_latency
+
+#ifndef HOST_NETWORK_H
+#define HOST_NETWORK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// tcp segments lwIP sent to the tap
+typedef struct {
+  uint32_t segments;      // all of them, handshake and acks included
+  uint32_t data_segments; // carrying payload
+  uint32_t data_bytes;
+} host_network_tcp_stats_t;
+
+void host_network_get_tcp_stats(host_network_tcp_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_NETWORK_H
@@ -0,0 +1,226 @@
+// host (linux) implementation of the pico sdk subset used by the firmware sources
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "uart_console.h"
+
+/* clock ======================================== */
+
+static uint64_t clock_base_us = 0;
+static uint64_t clock_offset_us = 0;
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+uint64_t time_us_64(void) {
+    if (clock_base_us == 0) {
+        clock_base_us = monotonic_us();
+    }
+    return monotonic_us() - clock_base_us + clock_offset_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+void sleep_us(uint64_t us) {
+    struct timespec ts = {
+        .tv_sec = us / 1000000u,
+        .tv_nsec = (us % 1000000u) * 1000u,
+    };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000u);
+}
+
+void host_clock_advance_us(uint64_t us) {
+    clock_offset_us += us;
+}
+
+/* gpio ========================================= */
+
+static bool gpio_level[NUM_BANK0_GPIOS];
+static uint32_t gpio_irq_mask[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_irq_callback = NULL;
+static bool gpio_irq_enabled = false;
+
+void gpio_init(uint gpio) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = false;
+        gpio_irq_mask[gpio] = 0;
+    }
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_pull_up(uint gpio) {
+    // inputs idle high like on the board
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = true;
+    }
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = value;
+    }
+}
+
+bool gpio_get(uint gpio) {
+    return gpio < NUM_BANK0_GPIOS ? gpio_level[gpio] : false;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    if (gpio >= NUM_BANK0_GPIOS) {
+        return;
+    }
+
+    if (enabled) {
+        gpio_irq_mask[gpio] |= event_mask;
+    } else {
+        gpio_irq_mask[gpio] &= ~event_mask;
+    }
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    gpio_irq_callback = callback;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num == IO_IRQ_BANK0) {
+        gpio_irq_enabled = enabled;
+    }
+}
+
+void host_gpio_set(uint gpio, bool value) {
+    if (gpio >= NUM_BANK0_GPIOS || gpio_level[gpio] == value) {
+        return;
+    }
+
+    gpio_level[gpio] = value;
+
+    uint32_t event = value ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if (gpio_irq_enabled && gpio_irq_callback && (gpio_irq_mask[gpio] & event)) {
+        gpio_irq_callback(gpio, event);
+    }
+}
+
+/* uart / stdio ================================= */
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    (void)uart;
+    return baudrate;
+}
+
+void uart_set_fifo_enabled(uart_inst_t *uart, bool enabled) {
+    (void)uart;
+    (void)enabled;
+}
+
+void uart_puts(uart_inst_t *uart, const char *s) {
+    (void)uart;
+    fputs(s, stdout);
+}
+
+bool stdio_init_all(void) {
+    stdio_uart_init();
+    return true;
+}
+
+void stdio_uart_init(void) {
+    setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+
+    if (poll(&pfd, 1, (int)(timeout_us / 1000)) <= 0 || !(pfd.revents & POLLIN)) {
+        return PICO_ERROR_TIMEOUT;
+    }
+
+    unsigned char c;
+    if (read(STDIN_FILENO, &c, 1) != 1) {
+        return PICO_ERROR_TIMEOUT;
+    }
+
+    return c;
+}
+
+/* uart console ================================= */
+
+// stdout is the console on the host, there is no fifo to wait for. the
+// counters still move so the stats output looks the same as on the device
+
+static uart_console_stats_t console_stats;
+
+bool uart_console_init(uart_inst_t *uart, uint baudrate, uint tx_pin, uint rx_pin) {
+    (void)tx_pin;
+    (void)rx_pin;
+    uart_init(uart, baudrate);
+    stdio_uart_init();
+    return true;
+}
+
+size_t uart_console_write(const char *buf, size_t len) {
+    size_t n = fwrite(buf, 1, len, stdout);
+    console_stats.written += n;
+    if (n < len) {
+        console_stats.dropped += len - n;
+        console_stats.drops++;
+    }
+    return n;
+}
+
+void uart_console_flush(void) {
+    fflush(stdout);
+}
+
+void uart_console_get_stats(uart_console_stats_t *stats) {
+    *stats = console_stats;
+}
+
+/* unique id ==================================== */
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out) {
+    static const uint8_t default_id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = {0xe6, 0x61, 0x48, 0x64, 0x43, 0x2d, 0x00, 0x01};
+    memcpy(id_out->id, default_id, sizeof(default_id));
+
+    const char *env = getenv("BMMSC_BOARD_ID");
+    if (env) {
+        unsigned long long v = strtoull(env, NULL, 16);
+        for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++) {
+            id_out->id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES - 1 - i] = (uint8_t)(v >> (8 * i));
+        }
+    }
+}
@@ -0,0 +1,16 @@
+// host (linux) stand-in for hardware/sync.h, there are no interrupts to mask
+
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+#endif // HOST_HARDWARE_SYNC_H
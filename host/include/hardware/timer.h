@@ -0,0 +1,8 @@
+// host (linux) stand-in for hardware/timer.h
+
+#ifndef HOST_HARDWARE_TIMER_H
+#define HOST_HARDWARE_TIMER_H
+
+#include "pico/time.h"
+
+#endif // HOST_HARDWARE_TIMER_H
@@ -0,0 +1,26 @@
+// host (linux) stand-in for hardware/uart.h, everything goes to stdout
+
+#ifndef HOST_HARDWARE_UART_H
+#define HOST_HARDWARE_UART_H
+
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uart_inst uart_inst_t;
+
+#define uart0 ((uart_inst_t *)0)
+#define uart1 ((uart_inst_t *)1)
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_set_fifo_enabled(uart_inst_t *uart, bool enabled);
+void uart_puts(uart_inst_t *uart, const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_HARDWARE_UART_H
@@ -0,0 +1,8 @@
+// host (linux) stand-in for pico/binary_info.h
+
+#ifndef HOST_PICO_BINARY_INFO_H
+#define HOST_PICO_BINARY_INFO_H
+
+#define bi_decl(_decl)
+
+#endif // HOST_PICO_BINARY_INFO_H
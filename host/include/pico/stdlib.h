@@ -0,0 +1,30 @@
+// host (linux) stand-in for pico/stdlib.h
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool stdio_init_all(void);
+void stdio_uart_init(void);
+
+// non blocking read from stdin, PICO_ERROR_TIMEOUT when nothing is pending
+int getchar_timeout_us(uint32_t timeout_us);
+
+static inline void tight_loop_contents(void) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PICO_STDLIB_H
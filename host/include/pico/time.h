@@ -0,0 +1,32 @@
+// host (linux) stand-in for pico/time.h
+//
+// time_us_64() runs on a virtual clock: CLOCK_MONOTONIC plus an offset that
+// test/bench code can move forward with host_clock_advance_us(). this lets
+// debounce and long press timing be skipped without sleeping.
+
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+
+// host only: move the virtual clock forward
+void host_clock_advance_us(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PICO_TIME_H
@@ -0,0 +1,27 @@
+// host (linux) stand-in for the pico sdk headers used by the firmware sources
+
+#ifndef HOST_PICO_TYPES_H
+#define HOST_PICO_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define __unused __attribute__((unused))
+
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT -1
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PICO_TYPES_H
@@ -0,0 +1,25 @@
+// host (linux) stand-in for pico/unique_id.h
+
+#ifndef HOST_PICO_UNIQUE_ID_H
+#define HOST_PICO_UNIQUE_ID_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICO_UNIQUE_BOARD_ID_SIZE_BYTES 8
+
+typedef struct {
+    uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+} pico_unique_board_id_t;
+
+// derived from BMMSC_BOARD_ID env var (if set) so several host instances differ
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_PICO_UNIQUE_ID_H
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Static RAM budget per subsystem, from a GNU ld map file.
+
+usage: mem_budget.py firmware.elf.map [--top 15] [--out report.txt]
+
+Every input section placed in RAM (.data, .bss, scratch, stacks, heap) is
+charged to a subsystem by the object file it came from. The report lists the
+subsystems and the largest individual symbols. The firmware build runs this
+after linking and writes <target>.mem_budget.txt next to the elf.
+"""
+
+import argparse
+import re
+import shutil
+import subprocess
+import sys
+
+RAM_START = 0x20000000
+RAM_END = 0x20042000
+
+# first match wins, matched against the object / archive path
+SUBSYSTEMS = [
+    ("stacks", r"stack(1)?_dummy"),
+    ("heap", r"^\.heap"),
+    ("lwip", r"lwip"),
+    ("tinyusb", r"tinyusb|/tusb|rndis_reports"),
+    ("dhcp server", r"dhcpserver"),
+    ("trace", r"trace\.c"),
+    ("console", r"uart_console|usb_console"),
+    ("telemetry", r"telemetry|heap_guard"),
+    ("usb network", r"usb_network|usb_descriptors"),
+    ("lcd", r"Pico-LCD|LCD_1in14|GUI_Paint|DEV_Config|font\d+"),
+    ("app", r"main\.cc|three_button\.cc"),
+    ("pico sdk", r"pico[-_]sdk|rp2_common|/common/|pico_|hardware_|boot_stage2"),
+    ("libc / libgcc", r"lib(c|g|m|gcc|stdc\+\+|nosys)(_nano)?\.a"),
+]
+
+# " .bss.name  0xaddr  0xsize  object" possibly with the name on its own line
+SECTION_RE = re.compile(r"^ (\.[\w.$]+|COMMON)\s*$")
+SECTION_LINE_RE = re.compile(r"^ (\.[\w.$]+|COMMON)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.+)$")
+OUTPUT_RE = re.compile(r"^(\.[\w.]+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+
+
+def classify(path, section):
+    for name, pattern in SUBSYSTEMS:
+        if re.search(pattern, path) or re.search(pattern, section):
+            return name
+    return "other"
+
+
+def demangle(names):
+    tool = shutil.which("arm-none-eabi-c++filt") or shutil.which("c++filt")
+    if not tool or not names:
+        return names
+    out = subprocess.run([tool], input="\n".join(names), capture_output=True, text=True).stdout.split("\n")
+    return out[: len(names)] if len(out) >= len(names) else names
+
+
+def parse(lines):
+    """yield (output section, input section, size, object path) for RAM placements"""
+    in_map = False
+    output = None
+    pending = None
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+
+        m = OUTPUT_RE.match(line)
+        if m:
+            output = m.group(1)
+            pending = None
+            continue
+
+        m = SECTION_RE.match(line)
+        if m:
+            pending = m.group(1)
+            continue
+
+        m = SECTION_LINE_RE.match(line)
+        if m:
+            section = m.group(1) or pending
+            pending = None
+            addr = int(m.group(2), 16)
+            size = int(m.group(3), 16)
+            path = m.group(4).strip()
+            if section is None or size == 0 or not (RAM_START <= addr < RAM_END):
+                continue
+            yield output, section, size, path
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("map")
+    parser.add_argument("--top", type=int, default=15)
+    parser.add_argument("--out")
+    args = parser.parse_args()
+
+    with open(args.map, errors="replace") as f:
+        placements = list(parse(f))
+
+    totals = {}
+    symbols = []
+    for output, section, size, path in placements:
+        # data is copied from flash at boot, everything else (bss, stacks, heap) is just reserved
+        kind = "data" if output in (".data", ".scratch_x", ".scratch_y") else "bss"
+        subsystem = classify(path, output + section)
+        data, bss = totals.get(subsystem, (0, 0))
+        totals[subsystem] = (data + size, bss) if kind == "data" else (data, bss + size)
+
+        name = section
+        for prefix in (".bss.", ".data.", ".uninitialized_data.", ".scratch_x.", ".scratch_y.", ".time_critical."):
+            if name.startswith(prefix):
+                name = name[len(prefix):]
+        symbols.append((size, name, subsystem))
+
+    out = open(args.out, "w") if args.out else sys.stdout
+    grand = sum(d + b for d, b in totals.values())
+
+    print("static RAM by subsystem (bytes)", file=out)
+    print("  %-16s %8s %8s %8s %6s" % ("subsystem", "data", "bss", "total", "%"), file=out)
+    for name, (data, bss) in sorted(totals.items(), key=lambda kv: -(kv[1][0] + kv[1][1])):
+        print("  %-16s %8d %8d %8d %5.1f%%" % (name, data, bss, data + bss, 100.0 * (data + bss) / grand if grand else 0), file=out)
+    print("  %-16s %8s %8s %8d of %d" % ("total", "", "", grand, RAM_END - RAM_START), file=out)
+
+    symbols.sort(reverse=True)
+    top = symbols[: args.top]
+    names = demangle([name for _, name, _ in top])
+    print("\nlargest symbols", file=out)
+    for (size, _, subsystem), name in zip(top, names):
+        print("  %8d  %-14s %s" % (size, subsystem, name), file=out)
+
+    if args.out:
+        out.close()
+        with open(args.out) as f:
+            sys.stdout.write(f.read())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,23 @@
+#!/bin/sh
+# runs bench_latency against a fresh camera_emu on the tap link
+#
+# usage: host/run_bench.sh <build dir> [out.json] [camera_emu options...]
+# e.g.   host/run_bench.sh build-host bench.json --latency-ms 20 --jitter-ms 5
+#
+# camera_emu binds 10.0.7.16:80, so it needs root (or cap_net_bind_service).
+# compare two runs with: host/bench_compare.py baseline.json bench.json
+# options for bench_latency itself go in BENCH_ARGS, e.g. BENCH_ARGS=--no-prewarm
+
+set -e
+
+BUILD=${1:?build dir}
+OUT=${2:-bench_latency.json}
+shift 2 2>/dev/null || shift $#
+
+"$BUILD/camera_emu" --bind 10.0.7.16 "$@" &
+EMU=$!
+trap 'kill $EMU 2>/dev/null' EXIT
+sleep 0.2
+
+"$BUILD/bench_latency" --out "$OUT" $BENCH_ARGS > "$OUT.log"
+cat "$OUT"
@@ -0,0 +1,30 @@
+#!/bin/sh
+# creates the tap device used by the host build (see host/host_network.c)
+#
+# the kernel side of the tap stands in for the camera: it gets 10.0.7.16,
+# the address the firmware's dhcp server hands to the first client.
+#
+# usage: sudo host/setup_tap.sh [tap name] [user]
+#        sudo host/setup_tap.sh --dhcp [tap name] [user]   (lease from the firmware instead)
+
+set -e
+
+DHCP=0
+if [ "$1" = "--dhcp" ]; then
+    DHCP=1
+    shift
+fi
+
+TAP=${1:-bmmsc0}
+OWNER=${2:-${SUDO_USER:-$(id -un)}}
+
+ip tuntap del dev "$TAP" mode tap 2>/dev/null || true
+ip tuntap add dev "$TAP" mode tap user "$OWNER"
+ip link set "$TAP" up
+
+if [ "$DHCP" = "1" ]; then
+    echo "$TAP is up; start the firmware, then run: dhclient -v $TAP"
+else
+    ip addr add 10.0.7.16/24 dev "$TAP"
+    echo "$TAP is up with 10.0.7.16/24 (controller is 10.0.7.5)"
+fi
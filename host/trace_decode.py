@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Decode trace_dump() output into a readable timeline.
+
+usage: trace_decode.py [log] [--header trace.h] [--category http]
+
+Reads a serial log (or stdin), finds every TRACE BEGIN / TRACE END block and
+prints one line per record with the time since the first record, the delta to
+the previous one and the decoded event. Event names and formats are taken
+from the enum in trace.h, so new events need no change here.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+EVENT_RE = re.compile(r"^\s*TRACE_EV_(\w+)\s*=\s*(0x[0-9a-fA-F]+|\d+),\s*(?://\s*(.*))?$")
+FIELD_RE = re.compile(r"\{([ab])(?::([xs]))?\}")
+
+
+def load_events(header):
+    events = {}
+    with open(header) as f:
+        for line in f:
+            m = EVENT_RE.match(line)
+            if m:
+                events[int(m.group(2), 0)] = (m.group(1).lower(), (m.group(3) or "").strip())
+    return events
+
+
+def format_payload(fmt, a, b):
+    def field(m):
+        v = a if m.group(1) == "a" else b
+        if m.group(2) == "x":
+            return "%x" % v
+        if m.group(2) == "s" and v & 0x80000000:
+            return str(v - (1 << 32))
+        return str(v)
+
+    if not fmt:
+        return "a=%d b=%d" % (a, b)
+    return FIELD_RE.sub(field, fmt)
+
+
+def read_blocks(lines):
+    block = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE BEGIN"):
+            block = []
+        elif line.startswith("TRACE END"):
+            if block is not None:
+                yield block
+            block = None
+        elif block is not None and len(line) == 24:
+            try:
+                block.append((int(line[0:8], 16), int(line[8:12], 16), int(line[12:16], 16), int(line[16:24], 16)))
+            except ValueError:
+                pass
+
+
+def main():
+    default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "trace.h")
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("log", nargs="?")
+    parser.add_argument("--header", default=default_header)
+    parser.add_argument("--category", help="only show events whose name starts with this, e.g. http")
+    args = parser.parse_args()
+
+    events = load_events(args.header)
+    src = open(args.log, errors="replace") if args.log else sys.stdin
+
+    for n, block in enumerate(read_blocks(src)):
+        print("# dump %d, %d records" % (n, len(block)))
+
+        # the timestamp is the low 32 bits of the us clock, unwrap it
+        t = 0
+        first = prev = None
+        for ts, ev, a, b in block:
+            if prev is None:
+                t = ts
+            else:
+                t += (ts - (prev & 0xFFFFFFFF)) & 0xFFFFFFFF
+            prev = t
+
+            name, fmt = events.get(ev, ("0x%04x" % ev, ""))
+            if args.category and not name.startswith(args.category.lower()):
+                continue
+            if first is None:
+                first = last = t
+            print("%10.3f ms  +%8.3f  %-16s %s" % ((t - first) / 1000.0, (t - last) / 1000.0, name, format_payload(fmt, a, b)))
+            last = t
+
+
+if __name__ == "__main__":
+    main()
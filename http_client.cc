@@ -0,0 +1,701 @@
+extern "C" {
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "trace.h"
+}
+
+#include "http_client.h"
+
+/* request ====================================== */
+
+HttpRequest::HttpRequest(int _id, int _action) {
+    id = _id;
+    done = false;
+    headerEndPos = FixedString<HttpRequest::RESPONSE_SIZE>::npos;
+    startTs = time_us_64();
+    connectTs = 0;
+    firstByteTs = 0;
+    completeTs = 0;
+    error = ERR_OK;
+    timedOut = false;
+    retries = 0;
+    retryPending = false;
+    waitingForPcb = false;
+    prewarmed = false;
+    next = NULL;
+    chained = false;
+    pipelined = false;
+    pcb = NULL;
+    ip_addr_set_zero(&remote);
+    contentLength = -1;
+    statusCode = 0;
+    action = _action;
+    value = 0;
+}
+
+/* client ======================================= */
+
+// a whole request fits the smallest mss a peer may announce (536), so it is
+// never split over segments
+static_assert(decltype(HttpRequest::requestString)::capacity() <= 536, "request must fit one tcp segment");
+
+ip_addr_t HttpClient::target = IPADDR4_INIT_BYTES(10, 0, 7, 16);
+FixedString<63> HttpClient::host;
+
+int HttpClient::requestTimeoutMs = 3000;
+int HttpClient::maxRetries = 1;
+int HttpClient::prewarmMaxAgeMs = 4000;
+int HttpClient::closeMode = HttpClient::CLOSE_RESET;
+int HttpClient::openConnections = 0;
+
+struct tcp_pcb* HttpClient::spare = NULL;
+uint64_t HttpClient::spareOpenTs = 0;
+uint64_t HttpClient::spareConnectTs = 0;
+uint64_t HttpClient::spareRetryTs = 0;
+
+ObjectPool<HttpRequest, HttpClient::MAX_REQUESTS> HttpClient::requestPool;
+HttpStats HttpClient::stats;
+
+char* HttpClient::strcasestr(const char* haystack, const char* needle) {
+    if (!*needle)
+        return (char*)haystack;
+
+    for (; *haystack; ++haystack) {
+        const char* h = haystack;
+        const char* n = needle;
+
+        while (*h && *n && tolower((unsigned char)*h) == tolower((unsigned char)*n)) {
+            ++h;
+            ++n;
+        }
+
+        if (!*n)
+            return (char*)haystack;
+    }
+
+    return NULL;
+}
+
+int HttpClient::parse_content_length(const char *headers, const char *end) {
+    const char *cl_key = "Content-Length:";
+    const char *p = strcasestr(headers, cl_key);  // case-insensitive search, POSIX GNU extension
+
+    if (!p) return -1;  // Content-Length not found
+    if (end != NULL && p >= end) return -1;  // in the next pipelined response
+
+    p += strlen(cl_key);
+
+    // Skip whitespace after "Content-Length:"
+    while (*p == ' ' || *p == '\t') p++;
+
+    // Parse number
+    int content_length = atoi(p);
+    if (content_length < 0) return -1;
+
+    return content_length;
+}
+
+// "HTTP/1.1 204 No Content" -> 204, 0 if the status line doesn't parse
+int HttpClient::parse_status(const char *headers) {
+    const char *p = strchr(headers, ' ');
+    if (strncmp(headers, "HTTP/", 5) != 0 || p == NULL) {
+        return 0;
+    }
+    return atoi(p + 1);
+}
+
+struct tcp_pcb* HttpClient::newPcb() {
+    if (openConnections >= MAX_CONNECTIONS) {
+        return NULL;
+    }
+
+    struct tcp_pcb *pcb = tcp_new();
+    if (pcb == NULL) {
+        stats.pcbAllocFailed++;
+        return NULL;
+    }
+
+    openConnections++;
+    if (openConnections > stats.connectionsHighWater) {
+        stats.connectionsHighWater = openConnections;
+    }
+
+    // the request is written in one go, waiting for an ack first only delays it
+    tcp_nagle_disable(pcb);
+    return pcb;
+}
+
+// clear the callbacks and let go of pcb. complete: the response is in, so
+// closeMode decides between FIN and RST. true if the pcb was aborted
+bool HttpClient::closePcb(struct tcp_pcb* pcb, bool complete) {
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    openConnections--;
+
+    if (complete && closeMode == CLOSE_RESET && pcb->state == ESTABLISHED) {
+        stats.closedRst++;
+        tcp_abort(pcb);
+        return true;
+    }
+
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        return true;
+    }
+    stats.closedFin++;
+    return false;
+}
+
+// close the request's pcb (if any); its callbacks are cleared so late
+// segments never touch req
+bool HttpClient::detach(HttpRequest* req, bool complete) {
+    if (req->pcb == NULL) {
+        return false;
+    }
+    bool aborted = closePcb(req->pcb, complete);
+    req->pcb = NULL;
+    return aborted;
+}
+
+// send req again from updateQueue(), on a fresh connection
+void HttpClient::retry(HttpRequest* req) {
+    req->retries++;
+    req->retryPending = true;
+    req->prewarmed = false;
+    req->connectTs = 0;
+    stats.retries++;
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_RETRY, req->id, req->retries);
+}
+
+// detach the request from its pcb and mark it done. requests pipelined
+// behind it fail with it
+bool HttpClient::finish(HttpRequest* req, err_t err) {
+    bool aborted = detach(req, err == ERR_OK);
+
+    HttpRequest* rest = req->next;
+    req->next = NULL;
+    if (rest != NULL) {
+        rest->chained = false;
+        finish(rest, err != ERR_OK ? err : (err_t)ERR_CLSD);
+    }
+
+    req->error = err;
+    req->completeTs = time_us_64();
+    req->done = true;
+
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_DONE, req->id, err);
+
+    if (err != ERR_OK) {
+        stats.errors++;
+    }
+    stats.record(req->action, req->startTs, req->connectTs, req->firstByteTs, req->completeTs);
+    return aborted;
+}
+
+int HttpClient::sendReq(HttpRequest* req) {
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_QUEUE, req->id, req->action);
+
+    if (takeSpare(req)) {
+        return 0;
+    }
+
+    // out of connections: wait for one to close instead of failing the press
+    struct tcp_pcb *pcb = newPcb();
+    if (pcb == NULL) {
+        if (!req->waitingForPcb) {
+            req->waitingForPcb = true;
+            stats.pcbWaits++;
+        }
+        return -1;
+    }
+
+    req->waitingForPcb = false;
+    req->pcb = pcb;
+    tcp_arg(pcb, req);
+    tcp_recv(pcb, HttpClient::recv);
+    tcp_err(pcb, HttpClient::error);
+
+    err_t err = tcp_connect(pcb, &target, PORT, HttpClient::connected);
+
+    if (err != ERR_OK) {
+        req->pcb = NULL;
+        closePcb(pcb, false);
+        finish(req, err);
+    }
+
+    return 0;
+}
+
+// pcb is already freed by lwIP when this is called
+void HttpClient::error(void *arg, err_t err) {
+    if (arg == &spare) {
+        // refused or reset while idle, nobody was waiting for it
+        spare = NULL;
+        openConnections--;
+        spareRetryTs = time_us_64() + PREWARM_RETRY_MS * 1000ull;
+        stats.prewarmStale++;
+        return;
+    }
+
+    HttpRequest *req = (HttpRequest*)arg;
+    if (req == NULL) {
+        return;
+    }
+
+    req->pcb = NULL;
+    openConnections--;
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_ERROR, req->id, err);
+
+    // connection refused/reset before we got to send, or a reused connection
+    // (spare, pipeline) the camera had already dropped: try again from
+    // updateQueue()
+    bool unanswered = req->connectTs == 0 || ((req->prewarmed || req->pipelined) && req->firstByteTs == 0);
+    if (unanswered && !req->timedOut && req->retries < maxRetries) {
+        retry(req);
+        return;
+    }
+
+    finish(req, err);
+}
+
+err_t HttpClient::connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    if (arg == &spare) {
+        spareConnectTs = time_us_64();
+        return ERR_OK;
+    }
+
+    HttpRequest *req = (HttpRequest*)arg;
+
+    uint64_t now = time_us_64();
+
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_CONNECTED, req->id, err);
+
+    // headers and body of a request in one write, TCP_WRITE_FLAG_MORE only
+    // between the requests of a pipeline: a single request is a single
+    // segment with PSH, sent by the tcp_output() below before this callback
+    // returns
+    for (HttpRequest* r = req; r != NULL; r = r->next) {
+        r->connectTs = now;
+        ip_addr_copy(r->remote, pcb->remote_ip);
+        err = tcp_write(pcb, r->requestString.c_str(), r->requestString.size(), r->next != NULL ? TCP_WRITE_FLAG_MORE : 0);
+        if (err != ERR_OK) {
+            return finish(req, err) ? ERR_ABRT : ERR_OK;
+        }
+
+        stats.bytesSent += r->requestString.size();
+        TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_SENT, r->id, r->requestString.size());
+    }
+
+    err = tcp_output(pcb);
+    if (err != ERR_OK) {
+        return finish(req, err) ? ERR_ABRT : ERR_OK;
+    }
+    return ERR_OK;
+}
+
+err_t HttpClient::recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    if (arg == &spare) {
+        // the camera closed the idle connection (or talked before being asked)
+        if (p != NULL) {
+            pbuf_free(p);
+        }
+        spare = NULL;
+        spareRetryTs = time_us_64() + PREWARM_RETRY_MS * 1000ull;
+        stats.prewarmStale++;
+        return closePcb(pcb, false) ? ERR_ABRT : ERR_OK;
+    }
+
+    HttpRequest *req = (HttpRequest*)arg;
+
+    if (!p && req->prewarmed && req->firstByteTs == 0 && req->retries < maxRetries) {
+        // the camera closed the spare as the request went out
+        bool aborted = detach(req);
+        retry(req);
+        return aborted ? ERR_ABRT : ERR_OK;
+    }
+
+    if (!p && req->pipelined && req->firstByteTs == 0) {
+        // the camera closed after answering the request before, it doesn't
+        // keep connections alive. this one and the rest of the pipeline go
+        // out again on a new connection
+        bool aborted = detach(req);
+        req->pipelined = false;
+        req->connectTs = 0;
+        req->retryPending = true;
+        stats.pipelineResent++;
+        return aborted ? ERR_ABRT : ERR_OK;
+    }
+
+    if (!p) {
+        // Remote side closed the connection
+        TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_CLOSED, req->id, 0);
+
+        // mid-answer: a pipeline behind it goes out again
+        HttpRequest* rest = req->next;
+        req->next = NULL;
+        if (rest != NULL) {
+            rest->chained = false;
+            rest->retryPending = true;
+            stats.pipelineResent++;
+        }
+        return finish(req, ERR_OK) ? ERR_ABRT : ERR_OK;
+    }
+
+    if (err != ERR_OK) {
+        // Some error occurred, free buffer and bail
+        pbuf_free(p);
+        return finish(req, err) ? ERR_ABRT : ERR_OK;
+    }
+
+    if (req->firstByteTs == 0) {
+        req->firstByteTs = time_us_64();
+    }
+    stats.bytesReceived += p->tot_len;
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_RECV, req->id, p->tot_len);
+
+    // Tell lwIP we have received the data
+    tcp_recved(pcb, p->tot_len);
+
+    // on a pipelined connection one segment can carry the end of one answer
+    // and the start of the next, or more answers than one buffer holds: take
+    // what fits, pass complete answers on and go on with the rest
+    uint16_t off = 0;
+    size_t end;
+    while (true) {
+        off += take(req, p, off);
+        if (!responseComplete(req, &end)) {
+            break;
+        }
+        if (req->next == NULL) {
+            pbuf_free(p);
+            return finish(req, ERR_OK) ? ERR_ABRT : ERR_OK;
+        }
+        req = handOff(req, pcb, end);
+    }
+
+    bool fits = off == p->tot_len;
+    pbuf_free(p);
+
+    if (!fits) {
+        // response larger than the buffer, the body would never complete
+        return finish(req, ERR_MEM) ? ERR_ABRT : ERR_OK;
+    }
+    return ERR_OK;
+}
+
+// append p from off to req's response, as much as fits. returns the bytes taken
+uint16_t HttpClient::take(HttpRequest* req, const struct pbuf* p, uint16_t off) {
+    uint16_t taken = 0;
+    for (const struct pbuf* q = p; q != NULL; q = q->next) {
+        if (off >= q->len) {
+            off -= q->len;
+            continue;
+        }
+        size_t left = q->len - off;
+        size_t room = req->responseString.capacity() - req->responseString.size();
+        size_t n = left < room ? left : room;
+        if (n == 0) {
+            break;
+        }
+        req->responseString.append(static_cast<const char*>(q->payload) + off, n);
+        taken += n;
+        off = 0;
+    }
+    return taken;
+}
+
+// check if we are finished: headers are in and the body matches
+// content-length. end: where the response stops in responseString
+bool HttpClient::responseComplete(HttpRequest* req, size_t* end) {
+    if (req->headerEndPos == FixedString<HttpRequest::RESPONSE_SIZE>::npos) {
+        const char *header_end = strstr(req->responseString.c_str(), "\r\n\r\n");
+        if (header_end == NULL) {
+            return false;
+        }
+        req->headerEndPos = (header_end - req->responseString.c_str()) + 4;
+
+        // Parse headers here, extract status and Content-Length value
+        req->statusCode = parse_status(req->responseString.c_str());
+        req->contentLength = parse_content_length(req->responseString.c_str(), header_end);
+        TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_HEADERS, req->id, req->contentLength);
+    }
+
+    *end = req->headerEndPos + (req->contentLength > 0 ? req->contentLength : 0);
+    return req->responseString.size() >= *end;
+}
+
+// req is answered and the next request of the pipeline waits: it gets the
+// pcb and whatever of its answer came in with req's
+HttpRequest* HttpClient::handOff(HttpRequest* req, struct tcp_pcb* pcb, size_t end) {
+    HttpRequest* next = req->next;
+    req->next = NULL;
+    req->pcb = NULL;
+
+    next->chained = false;
+    next->pipelined = true;
+    next->pcb = pcb;
+    tcp_arg(pcb, next);
+
+    if (req->responseString.size() > end) {
+        next->firstByteTs = time_us_64();
+        next->responseString.append(req->responseString.c_str() + end, req->responseString.size() - end);
+        req->responseString.truncate(end);
+    }
+
+    finish(req, ERR_OK);
+    return next;
+}
+
+void HttpClient::setTarget(const ip_addr_t* ip, const char* hostName) {
+    // a spare to the old address is no use, the next updateQueue() opens one
+    // to the new one right away
+    if (spare != NULL) {
+        dropSpare();
+    }
+    spareRetryTs = 0;
+
+    ip_addr_copy(target, *ip);
+    if (hostName != nullptr && hostName[0] != 0) {
+        host.format("%s.local", hostName);
+    }
+    printf("http: camera %s at %s\n", hostHeader(), ipaddr_ntoa(&target));
+}
+
+const char* HttpClient::hostHeader() {
+    return host.size() > 0 ? host.c_str() : DEFAULT_HOST;
+}
+
+HttpRequest* HttpClient::allocRequest(int action) {
+    HttpRequest* req = requestPool.create(cnter++, action);
+    if (req == nullptr) {
+        stats.errors++;
+        TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_ERROR, cnter - 1, ERR_MEM);
+    }
+    return req;
+}
+
+void HttpClient::release(HttpRequest* req) {
+    requestPool.destroy(req);
+}
+
+HttpRequest* HttpClient::newPutRequest(int action, const char* path, const char* body, int value) {
+    HttpRequest* req = allocRequest(action);
+    if (req == nullptr) {
+        return nullptr;
+    }
+    req->value = value;
+
+    // fill req headers
+    req->requestString.format(
+        "PUT /control/api/v1/%s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: %d\r\n"
+        "Connection: %s\r\n"
+        "\r\n"
+        "%s",
+        path, hostHeader(), (int)strlen(body), pipelining ? "keep-alive" : "close", body);
+
+    queue(req);
+
+    return req;
+}
+
+HttpRequest* HttpClient::newGetRequest(int action, const char* path, int value) {
+    HttpRequest* req = allocRequest(action);
+    if (req == nullptr) {
+        return nullptr;
+    }
+    req->value = value;
+
+    req->requestString.format(
+        "GET /control/api/v1/%s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Accept: application/json\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        path, hostHeader(), pipelining ? "keep-alive" : "close");
+
+    queue(req);
+
+    return req;
+}
+
+// send request to server, or add it to the pipeline being collected
+void HttpClient::queue(HttpRequest* req) {
+    activeRequests.push_back(req);
+    stats.requests++;
+
+    if (!pipelining) {
+        sendReq(req);
+        return;
+    }
+
+    if (pipelineTail == nullptr) {
+        pipelineHead = req;
+    } else {
+        pipelineTail->next = req;
+        req->chained = true;
+        stats.pipelined++;
+    }
+    pipelineTail = req;
+}
+
+void HttpClient::beginPipeline() {
+    pipelining = true;
+    pipelineHead = nullptr;
+    pipelineTail = nullptr;
+}
+
+void HttpClient::sendPipeline() {
+    HttpRequest* head = pipelineHead;
+    pipelining = false;
+    pipelineHead = nullptr;
+    pipelineTail = nullptr;
+
+    if (head != nullptr) {
+        sendReq(head);
+    }
+}
+
+void HttpClient::updateQueue() {
+    uint64_t now = time_us_64();
+
+    for (HttpRequest* req : activeRequests) {
+        // a chained request goes out, and times out, with the one before it
+        if (req->done || req->chained) {
+            continue;
+        }
+
+        if (req->retryPending) {
+            req->retryPending = false;
+            sendReq(req);
+        } else if (req->waitingForPcb && openConnections < MAX_CONNECTIONS) {
+            sendReq(req);
+        } else if (now - req->startTs > requestTimeoutMs * 1000ull) {
+            req->timedOut = true;
+            stats.timeouts++;
+            TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_TIMEOUT, req->id, 0);
+            if (req->pcb != NULL) {
+                tcp_arg(req->pcb, NULL);
+                tcp_abort(req->pcb);
+                req->pcb = NULL;
+                openConnections--;
+            }
+            finish(req, ERR_TIMEOUT);
+        }
+    }
+
+    size_t firstDone = doneRequests.size();
+    size_t i = 0;
+    while (i < activeRequests.size()) {
+        if (activeRequests[i]->done) {
+            doneRequests.push_back(activeRequests[i]);
+            activeRequests.erase(i);
+        } else {
+            i++;
+        }
+    }
+
+    // after the move, so a handler can queue follow-up requests
+    if (onComplete != nullptr) {
+        for (size_t d = firstDone; d < doneRequests.size(); d++) {
+            onComplete(doneRequests[d], onCompleteCtx);
+        }
+    }
+
+    // handled, unless someone reads doneRequests: then the latest few stay
+    size_t keep = keepDone ? MAX_DONE_REQUESTS : 0;
+    while (doneRequests.size() > keep) {
+        release(doneRequests.front());
+        doneRequests.erase(0);
+    }
+
+    prewarm();
+}
+
+/* prewarmed connection ========================= */
+
+// open a spare connection if there is none, replace one that got too old
+void HttpClient::prewarm() {
+    uint64_t now = time_us_64();
+
+    if (spare != NULL && now - spareOpenTs > prewarmMaxAgeMs * 1000ull) {
+        dropSpare();
+    }
+    if (spare != NULL || prewarmMaxAgeMs <= 0 || now < spareRetryTs) {
+        return;
+    }
+
+    // no pcb left is fine, requests need them more
+    struct tcp_pcb *pcb = newPcb();
+    if (pcb == NULL) {
+        spareRetryTs = now + PREWARM_RETRY_MS * 1000ull;
+        return;
+    }
+
+    tcp_arg(pcb, &spare);
+    tcp_recv(pcb, HttpClient::recv);
+    tcp_err(pcb, HttpClient::error);
+
+    if (tcp_connect(pcb, &target, PORT, HttpClient::connected) != ERR_OK) {
+        tcp_arg(pcb, NULL);
+        tcp_err(pcb, NULL);
+        tcp_abort(pcb);
+        openConnections--;
+        spareRetryTs = now + PREWARM_RETRY_MS * 1000ull;
+        return;
+    }
+
+    spare = pcb;
+    spareOpenTs = now;
+    spareConnectTs = 0;
+    stats.prewarmOpened++;
+}
+
+// give the spare to req if it's still good. a connected spare sends right
+// away, one still in the handshake sends from connected() like a fresh pcb
+bool HttpClient::takeSpare(HttpRequest* req) {
+    if (spare == NULL) {
+        return false;
+    }
+
+    uint64_t age = time_us_64() - spareOpenTs;
+    bool alive = spare->state == ESTABLISHED || spare->state == SYN_SENT;
+    if (!alive || age > prewarmMaxAgeMs * 1000ull) {
+        dropSpare();
+        return false;
+    }
+
+    struct tcp_pcb *pcb = spare;
+    spare = NULL;
+
+    req->pcb = pcb;
+    req->prewarmed = true;
+    tcp_arg(pcb, req);
+    stats.prewarmUsed++;
+    TRACE(TRACE_CAT_HTTP, TRACE_EV_HTTP_PREWARM, req->id, (uint32_t)(age / 1000));
+
+    if (spareConnectTs != 0) {
+        connected(req, pcb, ERR_OK);
+    }
+    return true;
+}
+
+// close the spare without any callback: a RST, no close handshake the camera
+// has to answer
+void HttpClient::dropSpare() {
+    tcp_arg(spare, NULL);
+    tcp_recv(spare, NULL);
+    tcp_err(spare, NULL);
+    tcp_abort(spare);
+    spare = NULL;
+    openConnections--;
+    stats.prewarmStale++;
+}
@@ -0,0 +1,212 @@
+#pragma once
+extern "C" {
+#include <lwip/tcp.h>
+}
+
+#include "fixed_containers.h"
+#include "http_stats.h"
+
+/**
+ * one request to the camera's REST API (/control/api/v1). the request text
+ * and the response are kept in the object, nothing is allocated.
+ */
+class HttpRequest {
+public:
+
+    int id;
+    bool done;
+    uint64_t startTs; // queued
+
+    // timing, time_us_64() values, 0 until the phase is reached
+    uint64_t connectTs;
+    uint64_t firstByteTs;
+    uint64_t completeTs;
+
+    err_t error;      // ERR_OK, or why the request failed
+    bool timedOut;
+    int retries;
+    bool retryPending; // connect failed, updateQueue() sends it again
+    bool waitingForPcb; // all connections in use, updateQueue() sends it when one closes
+    bool prewarmed;    // sent on the connection opened ahead of time
+
+    // pipelining: the request sent right after this one on the same
+    // connection. a chained request waits for the one before it to be
+    // answered, that one owns the pcb until then
+    HttpRequest* next;
+    bool chained;
+    bool pipelined; // was answered on a connection after another request
+
+    struct tcp_pcb* pcb;
+    ip_addr_t remote; // where it went, zero until connected. see setTarget()
+
+    FixedString<512> requestString;
+
+    int contentLength;
+
+    // one answer: headers plus the largest body the camera sends, about
+    // 100 bytes (lens/iris). a pipeline's answers pass through one at a time
+    static const size_t RESPONSE_SIZE = 512;
+    FixedString<RESPONSE_SIZE> responseString;
+    size_t headerEndPos; // pointing behing /r/n/r/n
+    int statusCode;      // from the status line, 0 until the headers are in
+    int action;
+    int value;           // owner's data: the value written, sync generation, see Camera
+
+    HttpRequest(int _id, int _action);
+
+    // transport fine and a 2xx answer
+    bool ok() const {
+        return error == ERR_OK && statusCode >= 200 && statusCode < 300;
+    }
+
+    // response body, empty until the headers are in
+    const char* body() const {
+        return headerEndPos == FixedString<RESPONSE_SIZE>::npos ? "" : responseString.c_str() + headerEndPos;
+    }
+};
+
+/**
+ * raw lwIP http client, one tcp connection per request. requests live in a
+ * fixed pool; finished ones move from activeRequests to doneRequests in
+ * updateQueue(), which calls onComplete for each of them and then gives
+ * them back to the pool. with keepDone set they stay in doneRequests for
+ * whoever reads them (benchmarks) to release(), up to the latest
+ * MAX_DONE_REQUESTS.
+ *
+ * requests queued between beginPipeline() and sendPipeline() share one
+ * keep-alive connection instead: all are written at once and the camera
+ * answers them in order, so a sequence costs one round trip. a failure stops
+ * the rest of the pipeline; if the camera closes the connection after an
+ * answer anyway, the rest goes out again on a new one.
+ */
+class HttpClient {
+public:
+    const static int PORT = 80;
+
+    // where requests go: the client holding the dhcp lease, see setTarget().
+    // until the first lease it's the first address the dhcp server hands out
+    static ip_addr_t target;
+
+    // the camera's name for the Host header, <hostname>.local
+    static constexpr const char* DEFAULT_HOST = "Micro-Studio-Camera-4K-G2.local";
+    static FixedString<63> host;
+
+    // tunable at runtime from the console (set http.timeout_ms / http.retries)
+    static int requestTimeoutMs;
+    static int maxRetries;
+    // keep a connection to the camera open for the next request, replaced
+    // when older than this (0 = off). below the usual 5 s idle timeout of
+    // http servers, after which the camera would close it anyway
+    static int prewarmMaxAgeMs;
+
+    // wait this long before opening another spare after one failed
+    const static int PREWARM_RETRY_MS = 1000;
+
+    // how a connection is closed once its response is complete:
+    //   CLOSE_GRACEFUL - FIN; our pcb then sits in TIME_WAIT for 2 * TCP_MSL
+    //   CLOSE_RESET    - RST; the pcb is free at once. nothing is lost, the
+    //                    whole response is in and the request said close
+    // a connection the camera closed first always gets a FIN back
+    enum CloseMode { CLOSE_GRACEFUL, CLOSE_RESET };
+    static int closeMode; // a CloseMode, int for the console's set
+
+    // connections open at once, requests plus the spare. one less than
+    // lwIP's pool: whatever else is in the pool is in TIME_WAIT or closing,
+    // and tcp_new() recycles those, so it never runs dry. requests beyond
+    // this wait in activeRequests
+    const static int MAX_CONNECTIONS = MEMP_NUM_TCP_PCB - 1;
+    static int openConnections;
+
+    // requests in flight: every connection busy and as many waiting for one,
+    // plus a sync's 3 GETs and a 3 step macro. finished ones nobody released
+    // yet if keepDone count too
+    const static int MAX_REQUESTS = 2 * MAX_CONNECTIONS + 6;
+    const static int MAX_DONE_REQUESTS = 8;
+
+    // static: the pool is large and the client lives on the stack of main()
+    static ObjectPool<HttpRequest, MAX_REQUESTS> requestPool;
+
+    static HttpStats stats;
+
+    typedef void (*CompleteHandler)(HttpRequest* req, void* ctx);
+
+    FixedVector<HttpRequest*, MAX_REQUESTS> activeRequests;
+    FixedVector<HttpRequest*, MAX_REQUESTS> doneRequests;
+    int cnter = 0;
+    // keep finished requests in doneRequests after onComplete, off in the
+    // firmware so the whole pool is there for requests in flight
+    bool keepDone = false;
+
+    // called from updateQueue() once per finished request, may queue new ones
+    CompleteHandler onComplete = nullptr;
+    void* onCompleteCtx = nullptr;
+
+    static char* strcasestr(const char* haystack, const char* needle);
+    // end: where the headers stop, a Content-Length after it isn't theirs
+    static int parse_content_length(const char* headers, const char* end = nullptr);
+    static int parse_status(const char* headers);
+
+    // new requests go to ip, requests in flight keep their connection.
+    // hostName (without .local) replaces the Host header if given
+    static void setTarget(const ip_addr_t* ip, const char* hostName = nullptr);
+    static const char* hostHeader();
+
+    // take a request from the pool, nullptr (and counted as an error) when all are in use
+    HttpRequest* allocRequest(int action);
+
+    // give a finished request from doneRequests back to the pool
+    void release(HttpRequest* req);
+
+    // value is stored in the request for the onComplete handler. returns the
+    // queued request, nullptr when the pool is full
+    HttpRequest* newPutRequest(int action, const char* path, const char* body, int value = 0);
+    HttpRequest* newGetRequest(int action, const char* path, int value = 0);
+
+    // pipeline the requests queued until sendPipeline(), which sends them
+    void beginPipeline();
+    void sendPipeline();
+
+    // retries, timeouts, moving finished requests to doneRequests and
+    // opening the next spare connection
+    void updateQueue();
+
+private:
+    // pipeline being collected, see beginPipeline()
+    bool pipelining = false;
+    HttpRequest* pipelineHead = nullptr;
+    HttpRequest* pipelineTail = nullptr;
+
+    void queue(HttpRequest* req);
+    static uint16_t take(HttpRequest* req, const struct pbuf* p, uint16_t off);
+    static bool responseComplete(HttpRequest* req, size_t* end);
+    static HttpRequest* handOff(HttpRequest* req, struct tcp_pcb* pcb, size_t end);
+
+    // idle connection to the target, handed to the next request. opened
+    // from updateQueue() after every use, so a press finds the handshake done
+    static struct tcp_pcb* spare;
+    static uint64_t spareOpenTs;    // tcp_connect() issued
+    static uint64_t spareConnectTs; // handshake done, 0 while connecting
+    static uint64_t spareRetryTs;   // no new spare before this
+
+    static void prewarm();
+    static bool takeSpare(HttpRequest* req);
+    static void dropSpare();
+
+    // every pcb we own comes from newPcb() and goes through closePcb() or
+    // lwIP's error callback, which keeps openConnections honest
+    static struct tcp_pcb* newPcb();
+    static bool closePcb(struct tcp_pcb* pcb, bool complete);
+
+    // these return true if the pcb was aborted, an lwIP callback that
+    // called them must then return ERR_ABRT
+    static bool detach(HttpRequest* req, bool complete = false);
+    static bool finish(HttpRequest* req, err_t err);
+
+    static void retry(HttpRequest* req);
+    static int sendReq(HttpRequest* req);
+
+    // lwIP callbacks, arg is the HttpRequest or &spare
+    static void error(void* arg, err_t err);
+    static err_t connected(void* arg, struct tcp_pcb* pcb, err_t err);
+    static err_t recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err);
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+
+/**
+ * fixed bucket latency histogram. bucket i counts samples <= BOUNDS_US[i],
+ * the last bucket catches everything above.
+ */
+class LatencyHistogram {
+public:
+    static const int NUM_BUCKETS = 12;
+    static constexpr uint32_t BOUNDS_US[NUM_BUCKETS - 1] = {
+        1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 2000000
+    };
+
+    uint32_t buckets[NUM_BUCKETS] = {0};
+    uint32_t count = 0;
+    uint64_t sumUs = 0;
+    uint32_t maxUs = 0;
+
+    void add(uint32_t us) {
+        int i = 0;
+        while (i < NUM_BUCKETS - 1 && us > BOUNDS_US[i]) {
+            i++;
+        }
+        buckets[i]++;
+        count++;
+        sumUs += us;
+        if (us > maxUs) {
+            maxUs = us;
+        }
+    }
+
+    // upper bound (us) below which at least pct % of samples fall, bucket resolution
+    uint32_t percentile(int pct) const {
+        uint32_t target = (count * pct + 99) / 100;
+        uint32_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS - 1; i++) {
+            seen += buckets[i];
+            if (seen >= target) {
+                return BOUNDS_US[i];
+            }
+        }
+        return maxUs;
+    }
+
+    void print(const char* label) const {
+        if (count == 0) {
+            return;
+        }
+
+        printf("  %-10s n=%lu avg=%lu p50<=%lu p95<=%lu max=%lu us |", label,
+            (unsigned long)count, (unsigned long)(sumUs / count),
+            (unsigned long)percentile(50), (unsigned long)percentile(95), (unsigned long)maxUs);
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            printf(" %lu", (unsigned long)buckets[i]);
+        }
+        printf("\n");
+    }
+};
+
+/**
+ * http request timing and counters, aggregated per action type.
+ *
+ * all phases are measured from the moment a request was queued, so
+ * connect = tcp handshake (our side + link), firstByte - connect = camera
+ * think time, complete - firstByte = transfer of the rest of the response.
+ */
+class HttpStats {
+public:
+    static const int MAX_ACTIONS = 20;
+
+    enum Phase {
+        CONNECT = 0,
+        FIRST_BYTE,
+        COMPLETE,
+        NUM_PHASES
+    };
+
+    LatencyHistogram hist[MAX_ACTIONS][NUM_PHASES];
+
+    uint32_t requests = 0;
+    uint32_t completed = 0;
+    uint32_t errors = 0;
+    uint32_t timeouts = 0;
+    uint32_t retries = 0;
+    uint32_t bytesSent = 0;
+    uint32_t bytesReceived = 0;
+    uint32_t prewarmOpened = 0; // spare connections opened ahead of a request
+    uint32_t prewarmUsed = 0;   // requests sent on one
+    uint32_t prewarmStale = 0;  // closed unused: too old, or the camera dropped it
+    uint32_t pcbWaits = 0;      // requests that waited for a free connection
+    uint32_t pcbAllocFailed = 0; // tcp_new() came back empty
+    uint32_t closedFin = 0;
+    uint32_t closedRst = 0;     // complete responses closed with CLOSE_RESET
+    int connectionsHighWater = 0;
+    uint32_t pipelined = 0;      // requests sent behind another on one connection
+    uint32_t pipelineResent = 0; // ...that went out again, the camera closed first
+
+    // timestamps are time_us_64() values, 0 means the phase was not reached
+    void record(int action, uint64_t queueTs, uint64_t connectTs, uint64_t firstByteTs, uint64_t completeTs) {
+        if (action < 0 || action >= MAX_ACTIONS) {
+            return;
+        }
+
+        completed++;
+
+        if (connectTs) {
+            hist[action][CONNECT].add((uint32_t)(connectTs - queueTs));
+        }
+        if (firstByteTs) {
+            hist[action][FIRST_BYTE].add((uint32_t)(firstByteTs - queueTs));
+        }
+        if (completeTs) {
+            hist[action][COMPLETE].add((uint32_t)(completeTs - queueTs));
+        }
+    }
+
+    void reset() {
+        *this = HttpStats();
+    }
+
+    void dump(const char* const* actionNames, int numActions) const {
+        printCounters();
+        printHistograms(actionNames, numActions);
+    }
+
+    void printCounters() const {
+        printf("http: requests=%lu completed=%lu errors=%lu timeouts=%lu retries=%lu sent=%lu recv=%lu bytes\n",
+            (unsigned long)requests, (unsigned long)completed, (unsigned long)errors, (unsigned long)timeouts,
+            (unsigned long)retries, (unsigned long)bytesSent, (unsigned long)bytesReceived);
+        printf("http: prewarm opened=%lu used=%lu stale=%lu\n", (unsigned long)prewarmOpened,
+            (unsigned long)prewarmUsed, (unsigned long)prewarmStale);
+        printf("http: connections high water=%d waits=%lu tcp_new failed=%lu closed fin=%lu rst=%lu\n",
+            connectionsHighWater, (unsigned long)pcbWaits, (unsigned long)pcbAllocFailed, (unsigned long)closedFin,
+            (unsigned long)closedRst);
+        printf("http: pipelined=%lu resent=%lu\n", (unsigned long)pipelined, (unsigned long)pipelineResent);
+    }
+
+    void printHistograms(const char* const* actionNames, int numActions) const {
+        printf("http: buckets (ms) <=1 <=2 <=5 <=10 <=20 <=50 <=100 <=200 <=500 <=1000 <=2000 >2000\n");
+
+        static const char* phaseNames[NUM_PHASES] = {"connect", "firstByte", "complete"};
+
+        for (int a = 0; a < numActions && a < MAX_ACTIONS; a++) {
+            if (hist[a][COMPLETE].count == 0 && hist[a][CONNECT].count == 0) {
+                continue;
+            }
+
+            printf("%s:\n", actionNames[a]);
+            for (int p = 0; p < NUM_PHASES; p++) {
+                hist[a][p].print(phaseNames[p]);
+            }
+        }
+    }
+};
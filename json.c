@@ -0,0 +1,64 @@
+// json field lookup, see json.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+int get_json_value(const char *json, const char *key) {
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+  const char *pos = strstr(json, pattern);
+  if (pos) {
+    int value;
+    if (sscanf(pos + strlen(pattern), "%d", &value) == 1) {
+      return value;
+    }
+  }
+
+  // Return something invalid if not found or parsing fails
+  return UNDEF;
+}
+
+int get_json_bool(const char *json, const char *key) {
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+  const char *pos = strstr(json, pattern);
+  if (pos) {
+    pos += strlen(pattern);
+    // Skip whitespace after colon
+    while (*pos == ' ' || *pos == '\t' || *pos == '\n') {
+      pos++;
+    }
+
+    if (strncmp(pos, "true", 4) == 0) {
+      return 1;
+    } else if (strncmp(pos, "false", 5) == 0) {
+      return 0;
+    }
+  }
+
+  return UNDEF_BOOL;
+}
+
+int get_json_fixed(const char *json, const char *key, int scale) {
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+  const char *pos = strstr(json, pattern);
+  if (pos == NULL) {
+    return UNDEF;
+  }
+
+  char *end;
+  float value = strtof(pos + strlen(pattern), &end);
+  if (end == pos + strlen(pattern)) {
+    return UNDEF;
+  }
+
+  value *= scale;
+  return (int)(value < 0 ? value - 0.5f : value + 0.5f);
+}
@@ -0,0 +1,32 @@
+// minimal json field lookup for camera api responses
+//
+// the camera answers with small flat objects like {"gain": 18}. these look up
+// one key by string search, no parser and no allocation. shared by both
+// firmwares.
+
+#ifndef JSON_H
+#define JSON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// returned when the key is missing or the value doesn't parse
+#define UNDEF -10000
+#define UNDEF_BOOL -1
+
+// integer value of "key", or UNDEF
+int get_json_value(const char *json, const char *key);
+
+// 1 / 0 for true / false, or UNDEF_BOOL
+int get_json_bool(const char *json, const char *key);
+
+// number of "key" times scale, rounded: {"apertureStop": 2.8} with scale 10
+// gives 28. UNDEF if missing
+int get_json_fixed(const char *json, const char *key, int scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_H
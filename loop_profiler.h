@@ -0,0 +1,160 @@
+#pragma once
+#include "pico/stdlib.h"
+#include "trace.h"
+
+#include <stdio.h>
+
+/**
+ * main loop profiler. every iteration is split into stages:
+ *
+ *     profiler.begin();
+ *     usb_network_update_usb();  profiler.mark(STAGE_USB);
+ *     ...
+ *     profiler.end();
+ *
+ * mark() charges the time since the previous mark to the given stage. per
+ * stage it keeps min/avg/max, for whole iterations also a histogram. an
+ * iteration longer than slowThresholdUs is counted, traced and remembered
+ * together with the stage that took longest - the usual answer to "why did
+ * this button press wait".
+ */
+class LoopProfiler {
+public:
+    static const int MAX_STAGES = 8;
+    static const int NUM_BUCKETS = 10;
+    static const int NUM_SLOW = 8;
+
+    static constexpr uint32_t BOUNDS_US[NUM_BUCKETS - 1] = {
+        10, 20, 50, 100, 200, 500, 1000, 5000, 20000
+    };
+
+    struct Timing {
+        uint32_t count = 0;
+        uint32_t minUs = UINT32_MAX;
+        uint32_t maxUs = 0;
+        uint64_t sumUs = 0;
+
+        void add(uint32_t us) {
+            count++;
+            sumUs += us;
+            if (us < minUs) {
+                minUs = us;
+            }
+            if (us > maxUs) {
+                maxUs = us;
+            }
+        }
+
+        void print(const char* label) const {
+            if (count == 0) {
+                return;
+            }
+            printf("  %-10s min=%lu avg=%lu max=%lu us\n", label, (unsigned long)minUs,
+                (unsigned long)(sumUs / count), (unsigned long)maxUs);
+        }
+    };
+
+    struct SlowIteration {
+        uint64_t ts;
+        uint32_t totalUs;
+        int stage;
+        uint32_t stageUs;
+    };
+
+    uint32_t slowThresholdUs = 2000;
+
+    int addStage(const char* name) {
+        if (numStages >= MAX_STAGES) {
+            return MAX_STAGES - 1;
+        }
+        stageNames[numStages] = name;
+        return numStages++;
+    }
+
+    void begin() {
+        iterationStart = lastMark = time_us_32();
+        worstStage = -1;
+        worstStageUs = 0;
+    }
+
+    void mark(int stage) {
+        uint32_t now = time_us_32();
+        uint32_t us = now - lastMark;
+        lastMark = now;
+
+        stages[stage].add(us);
+        if (us >= worstStageUs) {
+            worstStage = stage;
+            worstStageUs = us;
+        }
+    }
+
+    void end() {
+        uint32_t us = time_us_32() - iterationStart;
+        iteration.add(us);
+
+        int i = 0;
+        while (i < NUM_BUCKETS - 1 && us > BOUNDS_US[i]) {
+            i++;
+        }
+        buckets[i]++;
+
+        if (us > slowThresholdUs) {
+            slowCount++;
+            slow[slowHead++ % NUM_SLOW] = {time_us_64(), us, worstStage, worstStageUs};
+            TRACE(TRACE_CAT_LOOP, TRACE_EV_LOOP_SLOW, worstStage, us);
+        }
+    }
+
+    void reset() {
+        for (int s = 0; s < MAX_STAGES; s++) {
+            stages[s] = Timing();
+        }
+        iteration = Timing();
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            buckets[b] = 0;
+        }
+        slowCount = 0;
+        slowHead = 0;
+    }
+
+    void report() const {
+        printf("loop: %lu iterations, %lu slower than %lu us\n", (unsigned long)iteration.count,
+            (unsigned long)slowCount, (unsigned long)slowThresholdUs);
+        iteration.print("iteration");
+        for (int s = 0; s < numStages; s++) {
+            stages[s].print(stageNames[s]);
+        }
+
+        printf("loop: buckets (us) <=10 <=20 <=50 <=100 <=200 <=500 <=1000 <=5000 <=20000 >20000\n ");
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            printf(" %lu", (unsigned long)buckets[b]);
+        }
+        printf("\n");
+
+        // most recent slow iterations, oldest first
+        uint32_t n = slowHead < NUM_SLOW ? slowHead : NUM_SLOW;
+        for (uint32_t i = slowHead - n; i != slowHead; i++) {
+            const SlowIteration& it = slow[i % NUM_SLOW];
+            printf("  slow at %llu us: %lu us, %s took %lu us\n", (unsigned long long)it.ts, (unsigned long)it.totalUs,
+                it.stage >= 0 ? stageNames[it.stage] : "?", (unsigned long)it.stageUs);
+        }
+    }
+
+private:
+    const char* stageNames[MAX_STAGES];
+    int numStages = 0;
+
+    Timing stages[MAX_STAGES];
+    Timing iteration;
+    uint32_t buckets[NUM_BUCKETS] = {0};
+
+    SlowIteration slow[NUM_SLOW];
+    uint32_t slowHead = 0;
+    uint32_t slowCount = 0;
+
+    uint32_t iterationStart = 0;
+    uint32_t lastMark = 0;
+    int worstStage = -1;
+    uint32_t worstStageUs = 0;
+};
@@ -21,6 +21,10 @@
 #define MEM_ALIGNMENT 4
 #define MEM_SIZE 4000
 #define MEMP_NUM_TCP_SEG 32
+// one tcp connection per camera request plus the prewarmed spare, see
+// HttpClient::MAX_CONNECTIONS. pcbs in TIME_WAIT share the pool and are
+// recycled by tcp_new() when it's exhausted
+#define MEMP_NUM_TCP_PCB 8
 #define MEMP_NUM_ARP_QUEUE 10
 #define PBUF_POOL_SIZE 24
 #define LWIP_ARP 1
@@ -35,10 +39,23 @@
 #define LWIP_NETIF_LINK_CALLBACK 1
 #define LWIP_NETIF_HOSTNAME 1
 #define LWIP_NETCONN 0
-#define MEM_STATS 0
+
+// always on, cheap counters for sizing MEM_SIZE and the pools (see telemetry.c)
+#define LWIP_STATS 1
+#define MEM_STATS 1
+#define MEMP_STATS 1
+#define LINK_STATS 1
 #define SYS_STATS 0
-#define MEMP_STATS 0
-#define LINK_STATS 0
+#ifdef NDEBUG
+// the per protocol counters cost code and cycles on every packet, debug builds only
+#define ETHARP_STATS 0
+#define IP_STATS 0
+#define IPFRAG_STATS 0
+#define ICMP_STATS 0
+#define IGMP_STATS 0
+#define UDP_STATS 0
+#define TCP_STATS 0
+#endif
 // #define ETH_PAD_SIZE                2
 #define LWIP_CHKSUM_ALGORITHM 3
 #define LWIP_DHCP 1
@@ -57,11 +74,15 @@
 #define LWIP_IGMP 1
 #define LWIP_NUM_NETIF_CLIENT_DATA 1
 #define MEMP_NUM_SYS_TIMEOUT (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 3)
+// .local names through the dns client (mdns_cache.h). the dns client takes a
+// udp pcb per source port next to dhcp server and mdns responder
+#define LWIP_DNS_SUPPORT_MDNS_QUERIES 1
+#define DNS_MAX_SOURCE_PORTS 1
+#define MEMP_NUM_UDP_PCB 5
 // #define LWIP_MULTICAST_TX_OPTIONS 1
 
 #ifndef NDEBUG
 #define LWIP_DEBUG 1
-#define LWIP_STATS 1
 #define LWIP_STATS_DISPLAY 1
 #endif
 
@@ -1,5 +1,4 @@
 extern "C" {
-#include <hardware/uart.h>
 #include <lwip/apps/mdns.h>
 #include <lwip/ip.h>
 #include <pico/stdlib.h>
@@ -9,11 +8,13 @@ extern "C" {
 #include "pico/binary_info.h"
 
 #include "dhcpserver/dhcpserver.h"
+#include "flash_store.h"
+#include "heap_guard.h"
+#include "serial.h"
+#include "telemetry.h"
+#include "uart_console.h"
+#include "usb_console.h"
 #include "usb_network.h"
-#include "lwip/apps/http_client.h" 
-#include "pico/time.h"
-
-#include "lwip/tcp.h"
 
 // lcd headers
 #include "DEV_Config.h"
@@ -22,6 +23,12 @@ extern "C" {
 #include "fonts.h"
 
 }
+
+#include "button.h"
+#include "camera.h"
+#include "camera_commands.h"
+#include "console.h"
+#include "system_commands.h"
 /*
 
 notes:
@@ -32,27 +39,6 @@ notes:
 
 */
 
-/* serial ======================================= */
-#define UART_ID uart0           // Use UART1
-#define BAUD_RATE 115200
-
-#define UART_TX_PIN 0           // UART1 TX on GPIO8
-#define UART_RX_PIN 1           // UART1 RX on GPIO9 (optional)
-
-void serial_init() {
-    uart_init(UART_ID, BAUD_RATE);
-    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);  // Optional if only TX
-
-    // Optional: enable UART FIFO
-    uart_set_fifo_enabled(UART_ID, true);
-}
-
-void serial_log(const char* msg) {
-    uart_puts(UART_ID, msg);
-    uart_puts(UART_ID, "\r\n");
-}
-
 /* network ====================================== */
 
 // usb network addresses
@@ -62,52 +48,6 @@ static const ip4_addr_t netmask = IPADDR4_INIT_BYTES(255, 255, 255, 0);
 static const ip4_addr_t gateway = IPADDR4_INIT_BYTES(0, 0, 0, 0);
 
 const uint LED_PIN = 25;
-const int PORT = 80;
-// const int PORT = 4000;
-
-#define BUF_SIZE 2048
-#define UNDEF -10000
-
-/** json parser ================================ */
-int get_json_value(const char* json, const char* key) {
-    char pattern[64];
-    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
-
-    char* pos = strstr(json, pattern);
-    if (pos) {
-        int value;
-        if (sscanf(pos + strlen(pattern), "%d", &value) == 1) {
-            return value;
-        }
-    }
-
-    // Return something invalid if not found or parsing fails
-    return UNDEF;
-}
-
-#define UNDEF_BOOL -1  // or use a separate error flag
-
-int get_json_bool(const char* json, const char* key) {
-    char pattern[64];
-    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
-
-    char* pos = strstr(json, pattern);
-    if (pos) {
-        pos += strlen(pattern);
-        // Skip whitespace after colon
-        while (*pos == ' ' || *pos == '\t' || *pos == '\n') {
-            pos++;
-        }
-
-        if (strncmp(pos, "true", 4) == 0) {
-            return 1;
-        } else if (strncmp(pos, "false", 5) == 0) {
-            return 0;
-        }
-    }
-
-    return UNDEF_BOOL;
-}
 
 /** buttons ==================================== */
 
@@ -122,252 +62,26 @@ class Buttons {
 public:
 
     const static int NUM_BUTTONS = 6;
-    static constexpr int BUTTON_PINS[NUM_BUTTONS] = {15, 17, 16, 20, 2, 18};
-    inline static volatile uint64_t last_interrupt_time[NUM_BUTTONS] = {0, 0, 0, 0, 0, 0};
-    inline static volatile bool button_pressed[NUM_BUTTONS] = {false, false, false, false, false, false};
-    const static int DEBOUNCE_TIME_MS = 200;
-
-    static void gpio_callback(uint gpio, uint32_t events) {
-        uint64_t now = time_us_64() / 1000;
-
-        for (int i = 0; i < NUM_BUTTONS; i++) {
-            if (gpio == BUTTON_PINS[i]) {
-                if ((now - last_interrupt_time[i]) < DEBOUNCE_TIME_MS) {
-                    return;  // Ignore bouncing
-                }
-                last_interrupt_time[i] = now;
-    
-                if (events & GPIO_IRQ_EDGE_FALL) {
-                    button_pressed[i] = true;
-                    printf("Button %d pressed\n", i);
-                } else if (events & GPIO_IRQ_EDGE_RISE) {
-                    // printf("Button %d released\n", i);
-                    }
-            }
-        }
-    }
-
-    Buttons() {
-        for (int i = 0; i < NUM_BUTTONS; i++) {
-            gpio_init(BUTTON_PINS[i]);
-            gpio_set_dir(BUTTON_PINS[i], GPIO_IN);
-            gpio_pull_up(BUTTON_PINS[i]);
-            gpio_set_irq_enabled(BUTTON_PINS[i],
-            GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-        }
-
-        // Set up shared callback
-        gpio_set_irq_callback(&gpio_callback);
-        irq_set_enabled(IO_IRQ_BANK0, true);
-    }
+    Button buttons[NUM_BUTTONS] = {Button(15), Button(17), Button(16), Button(20), Button(2), Button(18)};
 
     bool pressed(int i) {
-        if (button_pressed[i] == true) {
-            button_pressed[i] = false;
-            return true;
-        }
-
-        return false;
-    }
-};
-
-/** http ======================================== */
-
-class HttpClient {
-public:
-    inline static char buff[BUF_SIZE] = {0};
-    inline static int recv_len = 0;
-    inline static volatile bool reqDone = false;
-    inline static char* body = 0;
-
-    // template for PUT method. arg1 is method name (string), second is content len, and 3rd content (string)
-    inline static const char headerPut[] = 
-        "PUT /control/api/v1/%s HTTP/1.1\r\n"
-        "Host: Micro-Studio-Camera-4K-G2.local\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %d\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        "%s\r\n";
-
-    // template for GET method. arg 1 is string with method name (e.g. video/gain)
-    inline static char headerGet[] =
-        "GET /control/api/v1/%s HTTP/1.1\r\n"
-        "Host: Micro-Studio-Camera-4K-G2.local\r\n"
-        "Accept: application/json\r\n"
-        "Connection: close\r\n"
-        "\r\n";
-
-    inline static char httpReq[2048] = {0};
-
-    static char* strcasestr(const char* haystack, const char* needle) {
-        if (!*needle)
-            return (char*)haystack;
-
-        for (; *haystack; ++haystack) {
-            const char* h = haystack;
-            const char* n = needle;
-
-            while (*h && *n && tolower((unsigned char)*h) == tolower((unsigned char)*n)) {
-                ++h;
-                ++n;
-            }
-    
-            if (!*n)
-                return (char*)haystack;
-        }
-
-        return NULL;
-    }
-
-
-    static int parse_content_length(const char *headers) {
-        const char *cl_key = "Content-Length:";
-        const char *p = strcasestr(headers, cl_key);  // case-insensitive search, POSIX GNU extension
-
-        if (!p) return -1;  // Content-Length not found
-
-        p += strlen(cl_key);
-
-        // Skip whitespace after "Content-Length:"
-        while (*p == ' ' || *p == '\t') p++;
-
-        // Parse number
-        int content_length = atoi(p);
-        if (content_length < 0) return -1;
-
-        return content_length;
-    }
-
-    static err_t recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
-        printf("*** recv\n");
-        if (pcb != NULL && p != NULL) {
-            // Make sure not to overflow your buffer
-            int copy_len = p->tot_len;
-            if (recv_len + copy_len >= BUF_SIZE) {
-                copy_len = BUF_SIZE - recv_len - 1;  // leave space for null
-            }
-            pbuf_copy_partial(p, buff + recv_len, copy_len, 0);
-            recv_len += copy_len;
-            buff[recv_len] = 0;
-
-            printf("Received %d bytes, total %d\n", copy_len, recv_len);
-            printf("Buffer so far: %s\n", buff);
-
-            tcp_recved(pcb, p->tot_len);
-            pbuf_free(p);
-
-            // Do NOT close connection yet, wait for all data
-            // Usually connection closes when remote side sends FIN (p == NULL)
-
-            char *header_end = strstr(buff, "\r\n\r\n");
-            if (header_end) {
-                if (body == 0) {
-                    body = header_end + 4;
-                }
-                // Parse headers here, extract Content-Length value
-                int content_length = parse_content_length(buff);
-
-                int header_len = (header_end - buff) + 4;
-                int body_len = recv_len - header_len;
-
-                if (body_len >= content_length) {
-                    printf("setting reqDone to true (recv1)\n");
-                    reqDone = true;  // entire response received
-                    tcp_close(pcb);
-                    pcb = NULL;
-                }
-            }
-
-        } else {
-            // p == NULL means connection closed by remote side — finish up
-            printf("Connection closed by remote, total received: %d bytes\n", recv_len);
-            if (pcb != NULL) {
-                // reqDone = true;
-                // printf("setting reqDone to true (recv2)\n");
-            }
-            tcp_close(pcb);
-            pcb = NULL;
-        }
-        return ERR_OK;
-    }
-
-    static err_t connected(void *arg, struct tcp_pcb *pcb, 
-                                          err_t err)
-    {
-        gpio_put(LED_PIN, 1);  
-
-        printf("*** Connected. Sending header: \n%s", httpReq);
-        printf("====================\n");
-
-        err = tcp_write(pcb, httpReq, strlen(httpReq), 0);
-        if (err != ERR_OK) {
-            tcp_close(pcb);
-            pcb = NULL;
-            return err;
-        }
-
-        err = tcp_output(pcb);
-        if (err != ERR_OK) {
-            tcp_close(pcb);
-            pcb = NULL;
-        }
-        gpio_put(LED_PIN, 0);
-        return ERR_OK;
-    }
-
-    static int sendReq() {
-        printf("*** sendReq\n");
-        recv_len = 0;
-        body = 0;
-        printf("setting reqDone to false\n");
-        reqDone = false;
-        struct tcp_pcb *pcb = tcp_new();
-        tcp_recv(pcb, recv);
-        ip_addr_t ip;
-        IP4_ADDR(&ip, 10, 0, 7, 16);
-
-        err_t err = tcp_connect(pcb, &ip, PORT, connected);
-
-        if (err != ERR_OK) {
-            tcp_abort(pcb);
-        }
-
-        return 0;
-    }
-
-    static void sendPutInt(const char* method, const char* property, int value) {
-        char buff[128];
-        snprintf(buff, sizeof(buff), "{\"%s\": %d}", property, value);
-        snprintf(httpReq, sizeof(httpReq), headerPut, method, strlen(buff), buff);
-        sendReq();
-    }
-
-    static void sendPutBool(const char* method, const char* property, bool value) {
-        char buff[128];
-        snprintf(buff, sizeof(buff), "{\"%s\": %s}", property, value ? "true": "false");
-        snprintf(httpReq, sizeof(httpReq), headerPut, method, strlen(buff), buff);
-        sendReq();
-    }
+        // only presses matter here. take the release too, otherwise the
+        // button never arms for the next press
+        bool wasShort;
+        buttons[i].released(wasShort);
 
-    static void sendPut(const char* method) {
-        snprintf(httpReq, sizeof(httpReq), headerPut, method, 0, "");
-        sendReq();
-    }
-
-    static void sendGet(const char* method) {
-        char buff[128];
-        snprintf(httpReq, sizeof(httpReq), headerGet, method);
-        sendReq();
+        return buttons[i].pressed();
     }
 };
 
-
 /* LCD ========================================== */
 
 class  LCD {
 public:
 
+    // 65k colours, one UWORD per pixel
+    inline static UWORD framebuffer[LCD_1IN14_HEIGHT * LCD_1IN14_WIDTH];
+
     UWORD *image;
 
     LCD() {
@@ -376,9 +90,8 @@ public:
         LCD_1IN14_Init(HORIZONTAL);
         LCD_1IN14_Clear(WHITE);
 
-        // Create image buffer
-        UDOUBLE image_size = LCD_1IN14_HEIGHT * LCD_1IN14_WIDTH * 2;
-        image = (UWORD *)malloc(image_size);
+        // image buffer is static, see framebuffer below
+        image = framebuffer;
         Paint_NewImage((UBYTE *)image, LCD_1IN14.WIDTH, LCD_1IN14.HEIGHT, 0, WHITE);
         Paint_SetScale(65);
         Paint_SetRotate(ROTATE_0);
@@ -404,52 +117,29 @@ public:
 
 /* app state ==================================== */
 
+// lcd front-end, the camera state itself lives in Camera
 class App {
 public:
-    int gain;
-    int wb;
-    int shutter;
+    Camera& camera;
 
     int cursor;
 
-    int record;
-
-    enum Action {
-        NONE = 0,
-        SET_GAIN = 1,
-        SET_WB = 2,
-        SET_SHUTTER = 3,
-        SET_RECORD = 7,
-
-        GET_GAIN = 100,
-        GET_WB = 101,
-        GET_SHUTTER = 102,
-        GET_RECORD = 107,
-    };
-
     enum ChangeAction {
         UP = 0,
         DOWN = 1
     };
 
-    Action reqAction;
-
-    App() {
-        reqAction = NONE;
-
-        gain = 0;
-        wb = 3000;
-        shutter = 180;
-
+    App(Camera& _camera) : camera(_camera) {
         cursor = 0;
-
-        record = 0;
     }
 
     void updateLCD(LCD& lcd) {
         char buff[16];
 
-        if (record == 0) {
+        int gain = camera.state.get(CameraState::GAIN);
+        int wb = camera.state.get(CameraState::WB);
+
+        if (camera.state.get(CameraState::RECORD) == 0) {
             lcd.clear(WHITE);
         } else {
             lcd.clear(RED);
@@ -460,13 +150,30 @@ public:
                 GREEN, DOT_PIXEL_2X2, DRAW_FILL_FULL);
         }
 
-        snprintf(buff, sizeof(buff), "%4dK", wb);
+        // dashes until the camera told us
+        if (camera.state.known(CameraState::WB)) {
+            snprintf(buff, sizeof(buff), "%4dK", wb);
+        } else {
+            snprintf(buff, sizeof(buff), "----K");
+        }
         lcd.write(buff, 15, 20);
 
-        snprintf(buff, sizeof(buff), "%3ddB", gain);
+        if (camera.state.known(CameraState::GAIN)) {
+            snprintf(buff, sizeof(buff), "%3ddB", gain);
+        } else {
+            snprintf(buff, sizeof(buff), " --dB");
+        }
         lcd.write(buff, 135, 20);
 
 
+        // preset recalled last, cut to the box
+        if (camera.presetIndex >= 0) {
+            snprintf(buff, sizeof(buff), "%.5s", camera.presets[camera.presetIndex].name);
+        } else {
+            snprintf(buff, sizeof(buff), "scene");
+        }
+        lcd.write(buff, 15, 60);
+
         if (cursor == 0) {
             Paint_DrawRectangle(10, 10, 110, 40,
                          BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
@@ -481,134 +188,59 @@ public:
                          BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
         }
 
-        LCD_1IN14_Display(lcd.image);        
-
+        // values are shown as soon as they are requested, the marker tells
+        // whether the camera has taken them yet
+        drawMarker(CameraState::WB, 101, 12);
+        drawMarker(CameraState::GAIN, 221, 12);
+        drawMarker(CameraState::RECORD, 221, 115);
 
         lcd.flush();
     }
 
-    void changeGain(ChangeAction action) {
-        int step = 6;
+    // blue: waiting for the camera, red: refused and rolled back
+    void drawMarker(CameraState::Property prop, int x, int y) {
+        const CameraState::Entry& entry = camera.state.entry(prop);
 
-        if (action == UP && gain + step <= 36) {
-            gain += step;
-        } else if (action == DOWN && gain - step >= -12) {
-            gain -= step;
-        } else {
-            return;
+        if (entry.pending()) {
+            Paint_DrawRectangle(x, y, x + 7, y + 7, BLUE, DOT_PIXEL_1X1, DRAW_FILL_FULL);
+        } else if (entry.failed) {
+            Paint_DrawRectangle(x, y, x + 7, y + 7, RED, DOT_PIXEL_1X1, DRAW_FILL_FULL);
+            Paint_DrawRectangle(x, y, x + 7, y + 7, BLACK, DOT_PIXEL_1X1, DRAW_FILL_EMPTY);
         }
-
-        reqAction = SET_GAIN;
-        HttpClient::sendPutInt("video/gain", "gain", gain);
-    }
-
-    void doAutoFocus() {
-        HttpClient::sendPut("lens/focus/doAutoFocus");
     }
 
-    void toggleRecord() {
-        int newRecord = 1 - record;
-
-        reqAction = SET_RECORD;
+    void changeGain(ChangeAction action) {
+        int step = 6;
+        int gain = camera.state.get(CameraState::GAIN);
 
-        if (newRecord == 1) {
-            HttpClient::sendPutBool("transports/0/record", "recording", newRecord == 1);
-        } else {
-            HttpClient::sendPut("transports/0/stop");
+        if (action == UP && gain + step <= Camera::GAIN_MAX) {
+            camera.setGain(gain + step);
+        } else if (action == DOWN && gain - step >= Camera::GAIN_MIN) {
+            camera.setGain(gain - step);
         }
     }
 
     void changeWB(ChangeAction action) {
         int step = 100;
+        int wb = camera.state.get(CameraState::WB);
 
-        if (action == UP && wb + step <= 9900) {
-            wb += step;
-        } else if (action == DOWN && wb - step >= 1800) {
-            wb -= step;
-        } else {
-            return;
+        if (action == UP && wb + step <= Camera::WB_MAX) {
+            camera.setWB(wb + step);
+        } else if (action == DOWN && wb - step >= Camera::WB_MIN) {
+            camera.setWB(wb - step);
         }
-
-        reqAction = SET_WB;
-        HttpClient::sendPutInt("video/whiteBalance", "whiteBalance", wb);
     }
 
-    bool updateState() {
-        if (HttpClient::reqDone == false) {
-            // request not done yet
-            return false;
-        }
-
-        if (reqAction == SET_GAIN) {
-            printf("in SET_GAIN\n");
-            HttpClient::sendGet("video/gain");
-            reqAction = GET_GAIN;
-            printf("next action: GET_GAIN\n");
-            return false;
-        }
-
-        if (reqAction == GET_GAIN) {
-            printf("in GET_GAIN\n");
-            reqAction = NONE;
-
-            printf("body received:\n====%s====\n", HttpClient::body);
-            
-
-            int newGain = get_json_value(HttpClient::body, "gain");
-            printf("parsed value: %d\n", newGain);
-            if (newGain != UNDEF) {
-                gain = newGain;
-
-                return true;
-            }
-        }
-
-        if (reqAction == SET_WB) {
-            printf("in SET_WB\n");
-            HttpClient::sendGet("video/whiteBalance");
-            reqAction = GET_WB;
-            printf("next action: GET_WB\n");
-            return false;
-        }
-
-        if (reqAction == GET_WB) {
-            printf("in GET_WB\n");
-            reqAction = NONE;
-
-            printf("body received:\n====%s====\n", HttpClient::body);
-
-            int newWB = get_json_value(HttpClient::body, "whiteBalance");
-            printf("parsed value: %d\n", newWB);
-            if (newWB != UNDEF) {
-                wb = newWB;
-
-                return true;
-            } 
-        }
-
-        if (reqAction == SET_RECORD) {
-            printf("in SET_RECORD\n");
-            reqAction = GET_RECORD;
-            sleep_ms(100);
-            HttpClient::sendGet("transports/0/record");
-            printf("next action: GET_RECORD\n");
-            return false;
-        }
-
-        if (reqAction == GET_RECORD) {
-            printf("in GET_RECORD\n");
-            reqAction = NONE;
-
-            int newRec = get_json_bool(HttpClient::body, "recording");
-            if (newRec != UNDEF_BOOL) {
-                record = newRec;
+    // recall the next / previous used preset
+    void changePreset(ChangeAction action) {
+        int slot = camera.presetIndex;
+        for (int i = 0; i < Camera::NUM_PRESETS; i++) {
+            slot = (slot + (action == UP ? 1 : Camera::NUM_PRESETS - 1)) % Camera::NUM_PRESETS;
+            if (camera.presets[slot].mask != 0) {
+                camera.recallPreset(slot);
+                return;
             }
-
-            return true;
         }
-
-
-        return false;
     }
 
     void changeCursor(int diff) {
@@ -625,6 +257,9 @@ public:
 };
 
 int main() {
+    // before anything else runs, so the stack high-water mark covers setup too
+    telemetry_init();
+
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
 
@@ -633,14 +268,22 @@ int main() {
     sleep_ms(500);
     gpio_put(LED_PIN, 0);
 
-    stdio_uart_init();
-
     serial_init();
     serial_log("Serial initialized");
 
+    // before usb is up: repairing the store may erase a sector
+    flash_store_init();
+
     Buttons buttons;
-    HttpClient httpClient;
-    App app;
+    Camera camera;
+    App app(camera);
+
+    // tally: the onboard led follows the record state
+    camera.state.subscribe([](CameraState::Property prop, const CameraState::Entry& entry, void*) {
+        if (prop == CameraState::RECORD) {
+            gpio_put(LED_PIN, entry.value);
+        }
+    }, nullptr);
 
     LCD lcd;
     lcd.write("initializing...", 10, 20);
@@ -651,17 +294,47 @@ int main() {
         return -1;
     }
 
+    // console on the usb cdc interface, next to the uart
+    usb_console_init();
+
     // setup DHCP server
     dhcp_server_t dhcp_server;
     dhcp_server_init(&dhcp_server, (ip_addr_t *)&ownip, (ip_addr_t *)&netmask, false);
+    // the camera got its address: talk to it and read its settings, right
+    // as the ACK goes out
+    dhcp_server_set_lease_callback(&dhcp_server, [](void* arg, const dhcp_server_lease_event_t* ev) {
+        ((Camera*)arg)->linkUp(ev);
+    }, &camera);
+    // last session's lease and settings, shown until the camera answers
+    camera.restore(&dhcp_server);
 
     // enable mDNS
-    mdns_resp_init();
-    mdns_resp_add_netif(netif_default, "demo");
+    mdns_advertise(netif_default, "bmmsc4kg2_control");
+
+    // command console, "quit" leaves the main loop
+    static bool quit = false;
+
+    LoopProfiler profiler;
+    const int STAGE_USB = profiler.addStage("usb");
+    const int STAGE_LWIP = profiler.addStage("lwip");
+    const int STAGE_CONSOLE = profiler.addStage("console");
+    const int STAGE_BUTTONS = profiler.addStage("buttons");
+    const int STAGE_HTTP = profiler.addStage("http");
+    const int STAGE_LCD = profiler.addStage("lcd");
+
+    Console console;
+    SystemCommands::add(console, &dhcp_server, &profiler);
+    CameraCommands::add(console, camera);
+    console.add("quit", "leave the main loop and shut down", [](int, char**, void*) {
+        quit = true;
+        return true;
+    }, nullptr);
+
+    // everything is allocated now, the main loop runs without the heap
+    heap_guard_lock();
 
     // enter main loop
     printf("setup complete, entering main loop\n");
-    int key = 0;
 
     int lastState = 0;
     int alarm = 5;
@@ -669,13 +342,20 @@ int main() {
     app.updateLCD(lcd);
 
 
-    while ((key != 's') && (key != 'S')) {
-        usb_network_update();
-        key = getchar_timeout_us(0); // get any pending key press but don't wait
+    while (!quit) {
+        profiler.begin();
+
+        usb_network_update_usb();
+        profiler.mark(STAGE_USB);
 
-        uint64_t microseconds = time_us_64();
-        uint64_t seconds = microseconds / 1000000;
-        uint64_t state = seconds % 2;
+        usb_network_update_lwip();
+        profiler.mark(STAGE_LWIP);
+
+        console.poll();
+        profiler.mark(STAGE_CONSOLE);
+
+        // redraw once at the end of the iteration so the lcd gets its own stage
+        bool redraw = false;
 
         //int newGain = gain;
         if (buttons.pressed(JOY_UP)) {
@@ -683,6 +363,9 @@ int main() {
                 app.changeGain(App::DOWN);
             } else if (app.cursor == 0) {
                 app.changeWB(App::DOWN);
+            } else if (app.cursor == 2) {
+                app.changePreset(App::DOWN);
+                redraw = true;
             }
         }
 
@@ -691,30 +374,42 @@ int main() {
                 app.changeGain(App::UP);
             } else if (app.cursor == 0) {
                 app.changeWB(App::UP);
+            } else if (app.cursor == 2) {
+                app.changePreset(App::UP);
+                redraw = true;
             }
         }
 
         if (buttons.pressed(BUTTON_UP)) {
-            app.doAutoFocus();
+            camera.doAutoFocus();
         }
 
         if (buttons.pressed(BUTTON_DOWN)) {
-            app.toggleRecord();
+            camera.toggleRecord();
         }
 
         if (buttons.pressed(JOY_LEFT)) {
             app.changeCursor(-1);
-            app.updateLCD(lcd);
+            redraw = true;
         }
 
         if (buttons.pressed(JOY_RIGHT)) {
             app.changeCursor(1);
-            app.updateLCD(lcd);
+            redraw = true;
         }
+        profiler.mark(STAGE_BUTTONS);
 
-        if (app.updateState()) {
+        if (camera.update()) {
+            redraw = true;
+        }
+        profiler.mark(STAGE_HTTP);
+
+        if (redraw) {
             app.updateLCD(lcd);
         }
+        profiler.mark(STAGE_LCD);
+
+        profiler.end();
 
         // prevent cpu burning (?)
         tight_loop_contents();
@@ -726,5 +421,7 @@ int main() {
     dhcp_server_deinit(&dhcp_server);
     usb_network_deinit();
 
+    uart_console_flush();
+
     return 0;
 }
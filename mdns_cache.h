@@ -0,0 +1,168 @@
+#pragma once
+#include "fixed_containers.h"
+#include "pico/stdlib.h"
+
+extern "C" {
+#include <lwip/apps/mdns.h>
+#include <lwip/dns.h>
+#include <pico/unique_id.h>
+#include <stdio.h>
+#include <strings.h>
+}
+
+/**
+ * .local names -> addresses, for a camera that didn't get its address from
+ * our dhcp server (fixed ip). lookup() answers from the cache and sends an
+ * mdns query (lwIP's dns client, LWIP_DNS_SUPPORT_MDNS_QUERIES) only when a
+ * name is new or its entry expired, so a name is resolved once per TTL_MS
+ * instead of per request. lwIP doesn't pass the record's ttl on, TTL_MS is
+ * the usual 120 s of mdns host records. while a refresh is out the old
+ * address keeps being returned.
+ */
+class MdnsCache {
+public:
+    static const int MAX_ENTRIES = 4;
+    static const uint32_t TTL_MS = 120000;
+    // a name nobody answered for is asked again after this long
+    static const uint32_t RETRY_MS = 5000;
+
+    // true and the address if name is known (possibly being refreshed)
+    bool lookup(const char* name, ip_addr_t* ip) {
+        uint64_t now = time_us_64();
+        Entry* e = find(name);
+        if (e == nullptr) {
+            e = evict();
+            e->name.assign(name);
+            e->valid = false;
+            e->pending = false;
+            e->expiresUs = 0;
+        }
+
+        if (!e->pending && now >= e->expiresUs) {
+            query(e);
+        }
+
+        if (e->valid) {
+            ip_addr_copy(*ip, e->ip);
+        }
+        return e->valid;
+    }
+
+    void print() const {
+        uint64_t now = time_us_64();
+        for (const Entry& e : entries) {
+            if (e.name.size() == 0) {
+                continue;
+            }
+            printf("  %-32s %-15s %s%lld s\n", e.name.c_str(), e.valid ? ipaddr_ntoa(&e.ip) : "-",
+                e.pending ? "querying, " : "", (long long)((int64_t)(e.expiresUs - now) / 1000000));
+        }
+        printf("mdns: %lu queries, %lu answers, %lu timeouts\n", (unsigned long)queries, (unsigned long)answers,
+            (unsigned long)timeouts);
+    }
+
+private:
+    struct Entry {
+        FixedString<63> name;
+        ip_addr_t ip;
+        uint64_t expiresUs = 0;
+        uint64_t usedUs = 0;
+        bool valid = false;
+        bool pending = false;
+    };
+
+    Entry entries[MAX_ENTRIES];
+    uint32_t queries = 0;
+    uint32_t answers = 0;
+    uint32_t timeouts = 0;
+
+    Entry* find(const char* name) {
+        for (Entry& e : entries) {
+            if (e.name.size() > 0 && strcasecmp(e.name.c_str(), name) == 0) {
+                e.usedUs = time_us_64();
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    // an empty slot, else the least recently used one
+    Entry* evict() {
+        Entry* oldest = &entries[0];
+        for (Entry& e : entries) {
+            if (e.name.size() == 0) {
+                return &e;
+            }
+            if (!e.pending && e.usedUs < oldest->usedUs) {
+                oldest = &e;
+            }
+        }
+        return oldest;
+    }
+
+    void query(Entry* e) {
+        queries++;
+        e->pending = true;
+
+        ip_addr_t ip;
+        err_t err = dns_gethostbyname(e->name.c_str(), &ip, found, this);
+        if (err == ERR_OK) {
+            // lwIP's own table still had it
+            found(e->name.c_str(), &ip, this);
+        } else if (err != ERR_INPROGRESS) {
+            e->pending = false;
+            e->expiresUs = time_us_64() + RETRY_MS * 1000ull;
+        }
+    }
+
+    static void found(const char* name, const ip_addr_t* ip, void* arg) {
+        MdnsCache* cache = (MdnsCache*)arg;
+        Entry* e = cache->find(name);
+        if (e == nullptr) {
+            // evicted while the query was out
+            return;
+        }
+
+        e->pending = false;
+        if (ip == nullptr) {
+            cache->timeouts++;
+            e->expiresUs = time_us_64() + RETRY_MS * 1000ull;
+            return;
+        }
+
+        cache->answers++;
+        ip_addr_copy(e->ip, *ip);
+        e->valid = true;
+        e->expiresUs = time_us_64() + TTL_MS * 1000ull;
+    }
+};
+
+/* advertisement ================================ */
+
+// a name no other controller on the network has: prefix plus the last three
+// bytes of the board id, e.g. bmmsc-3fa2c1
+inline void mdns_unique_name(const char* prefix, char* buf, size_t size) {
+    pico_unique_board_id_t id;
+    pico_get_unique_board_id(&id);
+    snprintf(buf, size, "%s-%02x%02x%02x", prefix, id.id[5], id.id[6], id.id[7]);
+}
+
+inline void mdns_device_info_txt(struct mdns_service* service, void* txt_userdata) {
+    const char* model = (const char*)txt_userdata;
+    char item[48];
+    int n = snprintf(item, sizeof(item), "model=%s", model);
+    mdns_resp_add_service_txtitem(service, item, (u8_t)n);
+}
+
+// answer for <unique name>.local and describe the device with a
+// _device-info._tcp record. there is no http server on the controller, so
+// it doesn't claim _http._tcp
+inline void mdns_advertise(struct netif* netif, const char* model) {
+    static char name[32];
+    mdns_unique_name("bmmsc", name, sizeof(name));
+
+    mdns_resp_init();
+    mdns_resp_add_netif(netif, name);
+    mdns_resp_add_service(netif, name, "_device-info", DNSSD_PROTO_TCP, 0, mdns_device_info_txt, (void*)model);
+    printf("mdns: %s.local\n", name);
+}
@@ -0,0 +1,15 @@
+// debug serial port, see serial.h
+
+#include <string.h>
+
+#include "serial.h"
+#include "uart_console.h"
+
+void serial_init(void) {
+  uart_console_init(UART_ID, BAUD_RATE, UART_TX_PIN, UART_RX_PIN);
+}
+
+void serial_log(const char *msg) {
+  uart_console_write(msg, strlen(msg));
+  uart_console_write("\r\n", 2);
+}
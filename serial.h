@@ -0,0 +1,28 @@
+// debug serial port
+//
+// both boards use uart0 on gpio 0/1 at 115200. stdio goes through the dma
+// console (uart_console.h), so printf never waits for the uart.
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UART_ID uart0
+#define BAUD_RATE 115200
+
+#define UART_TX_PIN 0
+#define UART_RX_PIN 1
+
+void serial_init(void);
+
+// one line, without going through printf
+void serial_log(const char *msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERIAL_H
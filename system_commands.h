@@ -0,0 +1,135 @@
+#pragma once
+#include "console.h"
+#include "loop_profiler.h"
+
+extern "C" {
+#include <lwip/stats.h>
+
+#include "dhcpserver/dhcpserver.h"
+#include "flash_store.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "uart_console.h"
+#include "usb_console.h"
+}
+
+/**
+ * console commands that don't depend on the app: trace ring, console
+ * counters, lwIP statistics, dhcp leases, flash store and the main loop
+ * profiler. shared by both firmwares.
+ */
+namespace SystemCommands {
+    dhcp_server_t* dhcpServer = nullptr;
+    LoopProfiler* profiler = nullptr;
+
+    bool trace(int argc, char** argv, void*) {
+        if (argc == 2 && strcmp(argv[1], "clear") == 0) {
+            trace_clear();
+            return true;
+        }
+        if (argc != 1) {
+            printf("usage: trace [clear]\n");
+            return false;
+        }
+        trace_dump();
+        return true;
+    }
+
+    bool serial(int, char**, void*) {
+        uart_console_stats_t stats;
+        uart_console_get_stats(&stats);
+        printf("uart console: written=%lu dropped=%lu bytes in %lu writes, high water=%lu/%d pending=%lu\n",
+            (unsigned long)stats.written, (unsigned long)stats.dropped, (unsigned long)stats.drops,
+            (unsigned long)stats.high_water, UART_CONSOLE_BUFFER_SIZE, (unsigned long)stats.pending);
+
+        usb_console_stats_t usbStats;
+        usb_console_get_stats(&usbStats);
+        printf("usb console: %s written=%lu dropped=%lu bytes in %lu writes\n", usb_console_connected() ? "open" : "closed",
+            (unsigned long)usbStats.written, (unsigned long)usbStats.dropped, (unsigned long)usbStats.drops);
+        return true;
+    }
+
+    bool mem(int argc, char** argv, void*) {
+        if (argc == 1) {
+            telemetry_report();
+            return true;
+        }
+
+        if (strcmp(argv[1], "lwip") == 0) {
+#if LWIP_STATS_DISPLAY
+            stats_display();
+            return true;
+#else
+            printf("full lwip stats are only in debug builds\n");
+            return false;
+#endif
+        }
+
+        printf("usage: mem [lwip]\n");
+        return false;
+    }
+
+    bool leases(int, char**, void*) {
+        if (dhcpServer == nullptr) {
+            printf("dhcp server not running\n");
+            return false;
+        }
+
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+        for (int i = 0; i < DHCPS_MAX_IP; i++) {
+            const dhcp_server_lease_t& lease = dhcpServer->lease[i];
+            if (!dhcp_server_is_leased(dhcpServer, i)) {
+                continue;
+            }
+
+            // expiry is stored in units of 65.536 s, same as dhcpserver.c
+            int32_t remaining = (int32_t)(((uint32_t)lease.expiry << 16 | 0xffff) - now) / 1000;
+            printf("  %u.%u.%u.%u %02x:%02x:%02x:%02x:%02x:%02x expires in %ld s\n",
+                ip4_addr1(ip_2_ip4(&dhcpServer->ip)), ip4_addr2(ip_2_ip4(&dhcpServer->ip)), ip4_addr3(ip_2_ip4(&dhcpServer->ip)),
+                DHCPS_BASE_IP + i, lease.mac[0], lease.mac[1], lease.mac[2], lease.mac[3], lease.mac[4], lease.mac[5],
+                (long)remaining);
+        }
+        return true;
+    }
+
+    bool flash(int, char**, void*) {
+        flash_store_stats_t stats;
+        flash_store_get_stats(&stats);
+        printf("flash store: %lu pages written, %lu unchanged writes skipped, %lu erases, seq %lu, next page %d\n",
+            (unsigned long)stats.writes, (unsigned long)stats.skipped, (unsigned long)stats.erases,
+            (unsigned long)stats.seq, stats.head);
+        return true;
+    }
+
+    bool uptime(int, char**, void*) {
+        printf("uptime %llu us\n", (unsigned long long)time_us_64());
+        return true;
+    }
+
+    bool loop(int argc, char** argv, void*) {
+        if (argc == 1) {
+            profiler->report();
+        } else if (strcmp(argv[1], "reset") == 0) {
+            profiler->reset();
+        } else if (argc == 3 && strcmp(argv[1], "threshold") == 0) {
+            profiler->slowThresholdUs = (uint32_t)atoi(argv[2]);
+        } else {
+            printf("usage: loop [reset | threshold <us>]\n");
+            return false;
+        }
+        return true;
+    }
+
+    void add(Console& console, dhcp_server_t* dhcp, LoopProfiler* loopProfiler) {
+        dhcpServer = dhcp;
+        profiler = loopProfiler;
+
+        console.add("trace", "[clear] dump or clear the trace ring", trace, nullptr);
+        console.add("serial", "uart / usb console counters", serial, nullptr);
+        console.add("mem", "[lwip] pool / heap high-water marks and stack depth", mem, nullptr);
+        console.add("leases", "dhcp leases", leases, nullptr);
+        console.add("flash", "flash store counters", flash, nullptr);
+        console.add("uptime", "microseconds since boot", uptime, nullptr);
+        console.add("loop", "[reset | threshold <us>] main loop stage timing", loop, nullptr);
+    }
+};
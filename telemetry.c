@@ -0,0 +1,124 @@
+// memory telemetry, see telemetry.h
+
+#include <malloc.h>
+#include <stdio.h>
+
+#include <lwip/memp.h>
+#include <lwip/stats.h>
+
+#include "telemetry.h"
+
+#define STACK_PAINT 0x5741434bu // "STAK"
+
+// memp pool names in MEMP_* order, the descriptions in stats_mem are only
+// compiled in with LWIP_DEBUG
+static const char *const memp_names[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) desc,
+#include "lwip/priv/memp_std.h"
+};
+
+#if PICO_ON_DEVICE
+
+// from the pico sdk linker script
+extern uint32_t __end__;
+extern uint32_t __StackLimit;
+extern uint32_t __StackBottom;
+extern uint32_t __StackTop;
+extern uint32_t __StackOneBottom;
+extern uint32_t __StackOneTop;
+
+static void paint(uint32_t *bottom, uint32_t *top) {
+  for (uint32_t *p = bottom; p < top; p++) {
+    *p = STACK_PAINT;
+  }
+}
+
+void telemetry_init(void) {
+  // leave some room below the current frame for paint() itself
+  uint32_t *sp = (uint32_t *)__builtin_frame_address(0) - 64;
+  paint(&__StackBottom, sp);
+
+  // core1 may be parked in the bootrom using the top of its stack
+  paint(&__StackOneBottom, &__StackOneTop - 64);
+}
+
+void telemetry_get_stack(unsigned core, telemetry_stack_t *stack) {
+  uint32_t *bottom = core == 0 ? &__StackBottom : &__StackOneBottom;
+  uint32_t *top = core == 0 ? &__StackTop : &__StackOneTop;
+
+  uint32_t *p = bottom;
+  while (p < top && *p == STACK_PAINT) {
+    p++;
+  }
+
+  stack->size = (size_t)(top - bottom) * sizeof(uint32_t);
+  stack->used = (size_t)(top - p) * sizeof(uint32_t);
+}
+
+void telemetry_get_heap(telemetry_heap_t *heap) {
+  struct mallinfo mi = mallinfo();
+  heap->in_use = mi.uordblks;
+  heap->free = mi.fordblks;
+  heap->arena = mi.arena;
+  heap->limit = (size_t)((char *)&__StackLimit - (char *)&__end__);
+}
+
+#else
+
+// host build: no stack painting, the heap is glibc's
+
+void telemetry_init(void) {}
+
+void telemetry_get_stack(unsigned core, telemetry_stack_t *stack) {
+  (void)core;
+  stack->size = 0;
+  stack->used = 0;
+}
+
+void telemetry_get_heap(telemetry_heap_t *heap) {
+  struct mallinfo2 mi = mallinfo2();
+  heap->in_use = mi.uordblks;
+  heap->free = mi.fordblks;
+  heap->arena = mi.arena;
+  heap->limit = 0;
+}
+
+#endif
+
+void telemetry_report(void) {
+  // lwip heap (MEM_SIZE)
+  struct stats_mem *mem = &lwip_stats.mem;
+  printf("lwip heap: used=%lu max=%lu of %lu err=%lu\n", (unsigned long)mem->used, (unsigned long)mem->max,
+    (unsigned long)mem->avail, (unsigned long)mem->err);
+
+  // pools, '!' marks a pool that ran dry at least once
+  printf("lwip pools:            used  max  size  err\n");
+  for (int i = 0; i < MEMP_MAX; i++) {
+    struct stats_mem *pool = lwip_stats.memp[i];
+    if (pool == NULL) {
+      continue;
+    }
+    printf("  %-18s %5lu %4lu %5lu %4lu%s\n", memp_names[i], (unsigned long)pool->used, (unsigned long)pool->max,
+      (unsigned long)pool->avail, (unsigned long)pool->err, pool->err ? " !" : (pool->max == pool->avail ? " full" : ""));
+  }
+
+  struct stats_proto *link = &lwip_stats.link;
+  printf("lwip link: xmit=%lu recv=%lu drop=%lu memerr=%lu err=%lu\n", (unsigned long)link->xmit, (unsigned long)link->recv,
+    (unsigned long)link->drop, (unsigned long)link->memerr, (unsigned long)link->err);
+
+  telemetry_heap_t heap;
+  telemetry_get_heap(&heap);
+  printf("heap: in use=%lu free=%lu arena=%lu", (unsigned long)heap.in_use, (unsigned long)heap.free, (unsigned long)heap.arena);
+  if (heap.limit) {
+    printf(" of %lu", (unsigned long)heap.limit);
+  }
+  printf("\n");
+
+  for (unsigned core = 0; core < 2; core++) {
+    telemetry_stack_t stack;
+    telemetry_get_stack(core, &stack);
+    if (stack.size) {
+      printf("stack core%u: used=%lu of %lu\n", core, (unsigned long)stack.used, (unsigned long)stack.size);
+    }
+  }
+}
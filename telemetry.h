@@ -0,0 +1,43 @@
+// memory telemetry: lwIP heap and pool high-water marks, C heap and stacks
+//
+// lwIP's MEM/MEMP/LINK counters are always compiled in (lwipopts.h), this
+// module only reads them. stacks are measured by painting: telemetry_init()
+// fills the unused part of each core's stack with a pattern and the report
+// looks for the deepest word that was overwritten since.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  size_t size; // total stack, 0 if unknown (host build)
+  size_t used; // deepest use since telemetry_init()
+} telemetry_stack_t;
+
+typedef struct {
+  size_t in_use; // bytes handed out by malloc / new
+  size_t free;   // free bytes inside the arena
+  size_t arena;  // heap claimed from the system so far, doubles as high-water mark
+  size_t limit;  // most the heap can grow to, 0 if unknown
+} telemetry_heap_t;
+
+// paint the stacks, call first thing in main()
+void telemetry_init(void);
+
+void telemetry_get_stack(unsigned core, telemetry_stack_t *stack);
+void telemetry_get_heap(telemetry_heap_t *heap);
+
+// print lwip heap / pools / link counters, C heap and stack use
+void telemetry_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,26 @@
+// compact binary event tracer, see trace.h
+
+#include <stdio.h>
+
+#include "trace.h"
+
+trace_record_t trace_ring[TRACE_BUFFER_SIZE];
+volatile uint32_t trace_head = 0;
+
+void trace_dump(void) {
+  // snapshot the head; records written while dumping may show up torn at
+  // the oldest end, which the decoder tolerates
+  uint32_t head = trace_head;
+  uint32_t count = head < TRACE_BUFFER_SIZE ? head : TRACE_BUFFER_SIZE;
+
+  printf("TRACE BEGIN %lu %lu %lu\n", (unsigned long)count, (unsigned long)head, (unsigned long)time_us_32());
+  for (uint32_t i = head - count; i != head; i++) {
+    const trace_record_t *r = &trace_ring[i & (TRACE_BUFFER_SIZE - 1)];
+    printf("%08lx%04x%04x%08lx\n", (unsigned long)r->ts_us, r->id, r->a, (unsigned long)r->b);
+  }
+  printf("TRACE END\n");
+}
+
+void trace_clear(void) {
+  trace_head = 0;
+}
@@ -0,0 +1,118 @@
+// compact binary event tracer
+//
+// TRACE(category, event, a, b) stores a 12 byte record (timestamp, event id,
+// two small payload words) in a RAM ring. it costs a timer read, an irq
+// save/restore and three stores, so it is safe on the hot path and in the
+// gpio isr. trace_dump() prints the ring as hex on demand; decode it on the
+// host with host/trace_decode.py.
+//
+// categories are selected at compile time with TRACE_CATEGORIES (bitmask of
+// TRACE_CAT_*); disabled TRACE() calls compile to nothing.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_CAT_BUTTON (1u << 0)
+#define TRACE_CAT_APP (1u << 1)
+#define TRACE_CAT_HTTP (1u << 2)
+#define TRACE_CAT_DHCP (1u << 3)
+#define TRACE_CAT_NET (1u << 4)
+#define TRACE_CAT_LOOP (1u << 5)
+#define TRACE_CAT_ALL (0xffffffffu)
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES (TRACE_CAT_BUTTON | TRACE_CAT_APP | TRACE_CAT_HTTP | TRACE_CAT_DHCP | TRACE_CAT_LOOP)
+#endif
+
+// must be a power of two
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 512
+#endif
+
+// event ids, high byte is the category. the comment after each id is the
+// format used by host/trace_decode.py ({a} and {b} are the payload words)
+enum trace_event_id {
+  TRACE_EV_BUTTON_EDGE = 0x0101, // gpio={a} events={b:x}
+
+  TRACE_EV_APP_ACTION = 0x0201, // action={a} value={b}
+  TRACE_EV_APP_STATE = 0x0202, // action={a} value={b}
+  TRACE_EV_APP_PROPERTY = 0x0203, // property={a} value={b:s}
+  TRACE_EV_APP_ROLLBACK = 0x0204, // property={a} back_to={b:s}
+  TRACE_EV_APP_SYNC = 0x0205, // properties={a} us={b}
+  TRACE_EV_APP_READY = 0x0206, // usb_up_to_first_answer_us={b}
+  TRACE_EV_APP_MACRO = 0x0207, // acknowledged={a} us={b}
+  TRACE_EV_APP_PRESET = 0x0208, // slot={a} writes={b}
+
+  TRACE_EV_HTTP_QUEUE = 0x0301, // req={a} action={b}
+  TRACE_EV_HTTP_CONNECTED = 0x0302, // req={a} err={b:s}
+  TRACE_EV_HTTP_SENT = 0x0303, // req={a} bytes={b}
+  TRACE_EV_HTTP_RECV = 0x0304, // req={a} bytes={b}
+  TRACE_EV_HTTP_HEADERS = 0x0305, // req={a} content_length={b:s}
+  TRACE_EV_HTTP_DONE = 0x0306, // req={a} err={b:s}
+  TRACE_EV_HTTP_CLOSED = 0x0307, // req={a} by remote
+  TRACE_EV_HTTP_ERROR = 0x0308, // req={a} err={b:s}
+  TRACE_EV_HTTP_RETRY = 0x0309, // req={a} retry={b}
+  TRACE_EV_HTTP_TIMEOUT = 0x030a, // req={a}
+  TRACE_EV_HTTP_PREWARM = 0x030b, // req={a} spare_age_ms={b}
+
+  TRACE_EV_DHCP_DISCOVER = 0x0401, // rapid_commit={a} mac_tail={b:x}
+  TRACE_EV_DHCP_OFFER = 0x0402, // ip=.{a} mac_tail={b:x}
+  TRACE_EV_DHCP_REQUEST = 0x0403, // mac_tail={b:x}
+  TRACE_EV_DHCP_ACK = 0x0404, // ip=.{a} mac_tail={b:x}
+  TRACE_EV_DHCP_NAK = 0x0405, // ip=.{a} mac_tail={b:x}
+  TRACE_EV_DHCP_RELEASE = 0x0406, // ip=.{a} mac_tail={b:x}
+  TRACE_EV_DHCP_INFORM = 0x0407, // ip=.{a} mac_tail={b:x}
+
+  TRACE_EV_NET_RX = 0x0501, // len={a}
+  TRACE_EV_NET_TX = 0x0502, // len={a}
+
+  TRACE_EV_LOOP_SLOW = 0x0601, // worst_stage={a} us={b}
+};
+
+typedef struct {
+  uint32_t ts_us;
+  uint16_t id;
+  uint16_t a;
+  uint32_t b;
+} trace_record_t;
+
+extern trace_record_t trace_ring[TRACE_BUFFER_SIZE];
+extern volatile uint32_t trace_head; // total records written, slot = head % size
+
+static inline void trace_event(uint16_t id, uint16_t a, uint32_t b) {
+  uint32_t save = save_and_disable_interrupts();
+  uint32_t slot = trace_head++ & (TRACE_BUFFER_SIZE - 1);
+  restore_interrupts(save);
+
+  trace_record_t *r = &trace_ring[slot];
+  r->ts_us = time_us_32();
+  r->id = id;
+  r->a = a;
+  r->b = b;
+}
+
+#define TRACE(cat, id, a, b)                                \
+  do {                                                      \
+    if ((TRACE_CATEGORIES) & (cat)) {                       \
+      trace_event((uint16_t)(id), (uint16_t)(a), (uint32_t)(b)); \
+    }                                                       \
+  } while (0)
+
+// print the ring, oldest first, as "TRACE BEGIN" / hex records / "TRACE END"
+void trace_dump(void);
+void trace_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
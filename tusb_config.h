@@ -116,6 +116,21 @@ extern "C" {
 #define CFG_TUD_ECM_RNDIS USE_ECM
 #define CFG_TUD_NCM (1 - CFG_TUD_ECM_RNDIS)
 
+// CDC-ACM serial console next to the network function (usb_console.c)
+#define CFG_TUD_CDC 1
+
+// full speed bulk endpoint
+#define CFG_TUD_CDC_EP_BUFSIZE 64
+
+// large tx fifo so a trace dump goes out in a few usb frames
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
+#define CFG_TUD_CDC_TX_BUFSIZE 2048
+#endif
+
+#ifndef CFG_TUD_CDC_RX_BUFSIZE
+#define CFG_TUD_CDC_RX_BUFSIZE 256
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,163 @@
+// non blocking uart console, see uart_console.h
+
+#include <string.h>
+
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <hardware/uart.h>
+#include <pico/stdio.h>
+#include <pico/stdio/driver.h>
+#include <pico/stdlib.h>
+
+#include "uart_console.h"
+
+static uart_inst_t *console_uart;
+static int dma_chan = -1;
+
+// free running indices, slot = index % size. the writer moves head, the dma
+// completion irq moves tail
+static char ring[UART_CONSOLE_BUFFER_SIZE];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+static volatile uint32_t in_flight; // bytes handed to the running dma transfer
+
+static uart_console_stats_t stats;
+
+// start draining the next contiguous run of the ring, if idle.
+// called with interrupts disabled or from the dma irq
+static void start_transfer(void) {
+  if (in_flight) {
+    return;
+  }
+
+  uint32_t avail = head - tail;
+  if (avail == 0) {
+    return;
+  }
+
+  uint32_t offset = tail & (UART_CONSOLE_BUFFER_SIZE - 1);
+  uint32_t count = UART_CONSOLE_BUFFER_SIZE - offset;
+  if (count > avail) {
+    count = avail;
+  }
+
+  in_flight = count;
+  dma_channel_transfer_from_buffer_now(dma_chan, &ring[offset], count);
+}
+
+static void dma_irq_handler(void) {
+  if (!dma_channel_get_irq1_status(dma_chan)) {
+    return;
+  }
+  dma_channel_acknowledge_irq1(dma_chan);
+
+  tail += in_flight;
+  in_flight = 0;
+  start_transfer();
+}
+
+size_t uart_console_write(const char *buf, size_t len) {
+  if (dma_chan < 0) {
+    return 0;
+  }
+
+  uint32_t save = save_and_disable_interrupts();
+
+  size_t space = UART_CONSOLE_BUFFER_SIZE - (head - tail);
+  size_t n = len < space ? len : space;
+
+  uint32_t offset = head & (UART_CONSOLE_BUFFER_SIZE - 1);
+  size_t first = UART_CONSOLE_BUFFER_SIZE - offset;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(&ring[offset], buf, first);
+  memcpy(&ring[0], buf + first, n - first);
+  head += n;
+
+  stats.written += n;
+  if (n < len) {
+    stats.dropped += len - n;
+    stats.drops++;
+  }
+  if (head - tail > stats.high_water) {
+    stats.high_water = head - tail;
+  }
+
+  start_transfer();
+
+  restore_interrupts(save);
+  return n;
+}
+
+void uart_console_flush(void) {
+  if (dma_chan < 0) {
+    return;
+  }
+
+  while (head != tail) {
+    tight_loop_contents();
+  }
+  uart_tx_wait_blocking(console_uart);
+}
+
+void uart_console_get_stats(uart_console_stats_t *out) {
+  uint32_t save = save_and_disable_interrupts();
+  *out = stats;
+  out->pending = head - tail;
+  restore_interrupts(save);
+}
+
+// stdio driver:
+
+static void console_out_chars(const char *buf, int len) {
+  uart_console_write(buf, (size_t)len);
+}
+
+static int console_in_chars(char *buf, int len) {
+  int n = 0;
+  while (n < len && uart_is_readable(console_uart)) {
+    buf[n++] = (char)uart_getc(console_uart);
+  }
+  return n ? n : PICO_ERROR_NO_DATA;
+}
+
+static stdio_driver_t console_driver = {
+  .out_chars = console_out_chars,
+  // no out_flush, stdio_flush() must not block. use uart_console_flush()
+  .in_chars = console_in_chars,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+  .crlf_enabled = PICO_STDIO_DEFAULT_CRLF,
+#endif
+};
+
+bool uart_console_init(uart_inst_t *uart, uint baudrate, uint tx_pin, uint rx_pin) {
+  console_uart = uart;
+
+  uart_init(uart, baudrate);
+  gpio_set_function(tx_pin, GPIO_FUNC_UART);
+  gpio_set_function(rx_pin, GPIO_FUNC_UART);
+  uart_set_fifo_enabled(uart, true);
+
+  dma_chan = dma_claim_unused_channel(false);
+  if (dma_chan < 0) {
+    return false;
+  }
+
+  // bytes from the ring into the uart data register, paced by the tx dreq
+  dma_channel_config c = dma_channel_get_default_config(dma_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+  dma_channel_configure(dma_chan, &c, &uart_get_hw(uart)->dr, NULL, 0, false);
+
+  dma_channel_set_irq1_enabled(dma_chan, true);
+  irq_add_shared_handler(DMA_IRQ_1, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, true);
+
+  stdio_set_driver_enabled(&console_driver, true);
+  return true;
+}
@@ -0,0 +1,49 @@
+// non blocking uart console
+//
+// stdio output is copied into a RAM ring and drained to the uart by DMA in the
+// background, so printf() never waits for the 32 byte uart fifo. when the ring
+// is full the bytes that don't fit are dropped and counted instead of stalling
+// the main loop. input is read straight from the uart rx fifo.
+
+#ifndef UART_CONSOLE_H
+#define UART_CONSOLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// must be a power of two
+#ifndef UART_CONSOLE_BUFFER_SIZE
+#define UART_CONSOLE_BUFFER_SIZE 4096
+#endif
+
+typedef struct {
+  uint32_t written;    // bytes accepted into the ring
+  uint32_t dropped;    // bytes thrown away because the ring was full
+  uint32_t drops;      // number of writes that lost at least one byte
+  uint32_t high_water; // most bytes ever waiting in the ring
+  uint32_t pending;    // bytes waiting right now, including the running transfer
+} uart_console_stats_t;
+
+// set up the uart, claim a dma channel and install the console as a stdio driver
+bool uart_console_init(uart_inst_t *uart, uint baudrate, uint tx_pin, uint rx_pin);
+
+// queue bytes for output, never blocks. returns the number of bytes queued
+size_t uart_console_write(const char *buf, size_t len);
+
+// wait until everything queued has left the uart (shutdown, before a reset)
+void uart_console_flush(void);
+
+void uart_console_get_stats(uart_console_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UART_CONSOLE_H
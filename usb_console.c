@@ -0,0 +1,55 @@
+// CDC-ACM serial console, see usb_console.h
+
+#include <pico/stdio.h>
+#include <pico/stdio/driver.h>
+#include <pico/stdlib.h>
+#include <tusb.h>
+
+#include "usb_console.h"
+
+static usb_console_stats_t stats;
+
+// whatever fits the cdc tx fifo, the rest is dropped and counted like in
+// uart_console. printf runs from lwip and tinyusb callbacks too, so this
+// must not service usb itself: tud_task() in the main loop drains the fifo
+static void console_out_chars(const char *buf, int len) {
+  if (!tud_cdc_connected()) {
+    return;
+  }
+
+  uint32_t n = tud_cdc_write(buf, (uint32_t)len);
+  stats.written += n;
+  if (n < (uint32_t)len) {
+    stats.dropped += (uint32_t)len - n;
+    stats.drops++;
+  }
+
+  tud_cdc_write_flush();
+}
+
+static int console_in_chars(char *buf, int len) {
+  if (!tud_cdc_available()) {
+    return PICO_ERROR_NO_DATA;
+  }
+  return (int)tud_cdc_read(buf, (uint32_t)len);
+}
+
+static stdio_driver_t console_driver = {
+  .out_chars = console_out_chars,
+  .in_chars = console_in_chars,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+  .crlf_enabled = PICO_STDIO_DEFAULT_CRLF,
+#endif
+};
+
+void usb_console_init(void) {
+  stdio_set_driver_enabled(&console_driver, true);
+}
+
+bool usb_console_connected(void) {
+  return tud_cdc_connected();
+}
+
+void usb_console_get_stats(usb_console_stats_t *out) {
+  *out = stats;
+}
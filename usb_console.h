@@ -0,0 +1,37 @@
+// CDC-ACM serial console on the usb composite device
+//
+// installs a second stdio driver next to uart_console, so printf output,
+// trace dumps and console input also go over usb (/dev/ttyACM0 on linux)
+// without an extra uart adapter. output is only sent while a terminal has the
+// port open (DTR set); otherwise it is dropped silently. a write never waits
+// for the host: what doesn't fit the tx fifo is dropped and counted.
+
+#ifndef USB_CONSOLE_H
+#define USB_CONSOLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t written; // bytes accepted into the cdc tx fifo
+  uint32_t dropped; // bytes lost to a full fifo while a terminal was open
+  uint32_t drops;   // number of writes that lost at least one byte
+} usb_console_stats_t;
+
+// install the stdio driver, call after usb_network_init() (which starts tinyusb)
+void usb_console_init(void);
+
+// a terminal has the port open
+bool usb_console_connected(void);
+
+void usb_console_get_stats(usb_console_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // USB_CONSOLE_H
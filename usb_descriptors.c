@@ -45,12 +45,16 @@ enum {
   STRID_PRODUCT,
   STRID_SERIAL,
   STRID_INTERFACE,
+  STRID_CONSOLE,
   STRID_MAC
 };
 
+// network function first, rndis hosts expect it on interface 0
 enum {
-  ITF_NUM_CDC = 0,
-  ITF_NUM_CDC_DATA,
+  ITF_NUM_NET = 0,
+  ITF_NUM_NET_DATA,
+  ITF_NUM_CONSOLE,
+  ITF_NUM_CONSOLE_DATA,
   ITF_NUM_TOTAL
 };
 
@@ -98,9 +102,9 @@ uint8_t const *tud_descriptor_device_cb(void) {
 //--------------------------------------------------------------------+
 // Configuration Descriptor
 //--------------------------------------------------------------------+
-#define MAIN_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_RNDIS_DESC_LEN)
-#define ALT_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_ECM_DESC_LEN)
-#define NCM_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_NCM_DESC_LEN)
+#define MAIN_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_RNDIS_DESC_LEN + TUD_CDC_DESC_LEN)
+#define ALT_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_ECM_DESC_LEN + TUD_CDC_DESC_LEN)
+#define NCM_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_NCM_DESC_LEN + TUD_CDC_DESC_LEN)
 
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X || CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
 // LPC 17xx and 40xx endpoint type (bulk/interrupt/iso) are fixed by its number
@@ -108,6 +112,9 @@ uint8_t const *tud_descriptor_device_cb(void) {
 #define EPNUM_NET_NOTIF 0x81
 #define EPNUM_NET_OUT 0x02
 #define EPNUM_NET_IN 0x82
+#define EPNUM_CONSOLE_NOTIF 0x84
+#define EPNUM_CONSOLE_OUT 0x05
+#define EPNUM_CONSOLE_IN 0x85
 
 #elif CFG_TUSB_MCU == OPT_MCU_CXD56
 // CXD56 USB driver has fixed endpoint type (bulk/interrupt/iso) and direction (IN/OUT) by its number
@@ -115,6 +122,9 @@ uint8_t const *tud_descriptor_device_cb(void) {
 #define EPNUM_NET_NOTIF 0x83
 #define EPNUM_NET_OUT 0x02
 #define EPNUM_NET_IN 0x81
+#define EPNUM_CONSOLE_NOTIF 0x86
+#define EPNUM_CONSOLE_OUT 0x05
+#define EPNUM_CONSOLE_IN 0x84
 
 #elif defined(TUD_ENDPOINT_ONE_DIRECTION_ONLY)
 // MCUs that don't support a same endpoint number with different direction IN and OUT defined in tusb_mcu.h
@@ -122,13 +132,23 @@ uint8_t const *tud_descriptor_device_cb(void) {
 #define EPNUM_NET_NOTIF 0x81
 #define EPNUM_NET_OUT 0x02
 #define EPNUM_NET_IN 0x83
+#define EPNUM_CONSOLE_NOTIF 0x84
+#define EPNUM_CONSOLE_OUT 0x05
+#define EPNUM_CONSOLE_IN 0x86
 
 #else
 #define EPNUM_NET_NOTIF 0x81
 #define EPNUM_NET_OUT 0x02
 #define EPNUM_NET_IN 0x82
+#define EPNUM_CONSOLE_NOTIF 0x83
+#define EPNUM_CONSOLE_OUT 0x04
+#define EPNUM_CONSOLE_IN 0x84
 #endif
 
+// Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+#define CONSOLE_DESCRIPTOR                                                                                                                           \
+  TUD_CDC_DESCRIPTOR(ITF_NUM_CONSOLE, STRID_CONSOLE, EPNUM_CONSOLE_NOTIF, 8, EPNUM_CONSOLE_OUT, EPNUM_CONSOLE_IN, CFG_TUD_CDC_EP_BUFSIZE)
+
 #if CFG_TUD_ECM_RNDIS
 
 static uint8_t const rndis_configuration[] = {
@@ -136,7 +156,9 @@ static uint8_t const rndis_configuration[] = {
   TUD_CONFIG_DESCRIPTOR(CONFIG_ID_RNDIS + 1, ITF_NUM_TOTAL, 0, MAIN_CONFIG_TOTAL_LEN, 0, 100),
 
   // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
-  TUD_RNDIS_DESCRIPTOR(ITF_NUM_CDC, STRID_INTERFACE, EPNUM_NET_NOTIF, 8, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE),
+  TUD_RNDIS_DESCRIPTOR(ITF_NUM_NET, STRID_INTERFACE, EPNUM_NET_NOTIF, 8, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE),
+
+  CONSOLE_DESCRIPTOR,
 };
 
 static uint8_t const ecm_configuration[] = {
@@ -145,8 +167,10 @@ static uint8_t const ecm_configuration[] = {
 
   // Interface number, description string index, MAC address string index, EP notification address and size, EP data address (out, in), and size, max
   // segment size.
-  TUD_CDC_ECM_DESCRIPTOR(ITF_NUM_CDC, STRID_INTERFACE, STRID_MAC, EPNUM_NET_NOTIF, 64, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE,
+  TUD_CDC_ECM_DESCRIPTOR(ITF_NUM_NET, STRID_INTERFACE, STRID_MAC, EPNUM_NET_NOTIF, 64, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE,
     CFG_TUD_NET_MTU),
+
+  CONSOLE_DESCRIPTOR,
 };
 
 #else
@@ -157,8 +181,10 @@ static uint8_t const ncm_configuration[] = {
 
   // Interface number, description string index, MAC address string index, EP notification address and size, EP data address (out, in), and size, max
   // segment size.
-  TUD_CDC_NCM_DESCRIPTOR(ITF_NUM_CDC, STRID_INTERFACE, STRID_MAC, EPNUM_NET_NOTIF, 64, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE,
+  TUD_CDC_NCM_DESCRIPTOR(ITF_NUM_NET, STRID_INTERFACE, STRID_MAC, EPNUM_NET_NOTIF, 64, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE,
     CFG_TUD_NET_MTU),
+
+  CONSOLE_DESCRIPTOR,
 };
 
 #endif
@@ -228,7 +254,7 @@ uint8_t const desc_ms_os_20[] = {
   U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION), 0, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
 
   // Function Subset header: length, type, first interface, reserved, subset length
-  U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), ITF_NUM_CDC, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
+  U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), ITF_NUM_NET, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
 
   // MS OS 2.0 Compatible ID descriptor: length, type, compatible ID, sub compatible ID
   U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID), 'W', 'I', 'N', 'N', 'C', 'M', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -294,7 +320,8 @@ static char const *string_desc_arr[] = {
   [STRID_MANUFACTURER] = "TinyUSB", // Manufacturer
   [STRID_PRODUCT] = "TinyUSB Device", // Product
   [STRID_SERIAL] = NULL, // Serials will use unique ID if possible
-  [STRID_INTERFACE] = "TinyUSB Network Interface" // Interface Description
+  [STRID_INTERFACE] = "TinyUSB Network Interface", // Interface Description
+  [STRID_CONSOLE] = "bmmsc console", // CDC-ACM console interface
 
   // STRID_MAC index is handled separately
 };
@@ -33,6 +33,7 @@
 #include <lwip/init.h>
 #include <lwip/ip.h>
 #include <lwip/opt.h>
+#include <lwip/stats.h>
 #include <lwip/timeouts.h>
 #include <netif/ethernet.h>
 #include <pico/stdlib.h>
@@ -53,18 +54,23 @@ static bool netif_added = false;
 // shared between tud_network_recv_cb() and service_traffic()
 static struct pbuf *received_frame;
 
+// time_us_64() of the last enumeration, see usb_network_up_us()
+static uint64_t up_us = 0;
+
 // network interface functions:
 
 static err_t tud_output(__unused struct netif *netif, struct pbuf *p) {
   for (;;) {
     // if TinyUSB isn't ready, signal back to lwip that there is nothing to do
     if (!tud_ready()) {
+      LINK_STATS_INC(link.drop);
       return ERR_USE;
     }
 
     // check if the network driver can accept another packet
     if (tud_network_can_xmit(p->tot_len)) {
       tud_network_xmit(p, 0);
+      LINK_STATS_INC(link.xmit);
       return ERR_OK;
     }
 
@@ -99,6 +105,15 @@ static err_t netif_init_cb(struct netif *netif) {
 
 // driver callbacks:
 
+// the host configured the device, the start of the "camera plugged in" clock
+void tud_mount_cb(void) {
+  up_us = time_us_64();
+}
+
+void tud_umount_cb(void) {
+  up_us = 0;
+}
+
 void tud_network_init_cb() {
   // if the network is re-initialising and there is a leftover packet, perform a cleanup
   if (received_frame) {
@@ -111,6 +126,7 @@ bool tud_network_recv_cb(const uint8_t *src, uint16_t size) {
   // this shouldn't happen, but if receive another packet before
   // parsing the previous one, signal cannot accept
   if (received_frame) {
+    LINK_STATS_INC(link.drop);
     return false;
   }
 
@@ -123,6 +139,11 @@ bool tud_network_recv_cb(const uint8_t *src, uint16_t size) {
 
       // store the pointer for service_traffic() to handle later
       received_frame = p;
+      LINK_STATS_INC(link.recv);
+    } else {
+      // out of PBUF_POOL, the frame is lost
+      LINK_STATS_INC(link.memerr);
+      LINK_STATS_INC(link.drop);
     }
   }
 
@@ -153,7 +174,15 @@ static inline void service_traffic() {
 }
 
 void usb_network_update() {
+  usb_network_update_usb();
+  usb_network_update_lwip();
+}
+
+void usb_network_update_usb() {
   tud_task();
+}
+
+void usb_network_update_lwip() {
   service_traffic();
 }
 
@@ -161,6 +190,10 @@ bool usb_network_is_up() {
   return tud_ready();
 }
 
+uint64_t usb_network_up_us() {
+  return up_us;
+}
+
 bool usb_network_init(const ip4_addr_t *ownip, const ip4_addr_t *netmask, const ip4_addr_t *gateway, bool init_lwip) {
   if (!tud_init(PICO_TUD_RHPORT)) {
     printf("usb_network: tud_init fail\n");
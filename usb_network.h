@@ -37,7 +37,12 @@ extern "C" {
 
 bool usb_network_init(const ip4_addr_t *ownip, const ip4_addr_t *netmask, const ip4_addr_t *gateway, bool init_lwip);
 bool usb_network_is_up();
+// time_us_64() when the host last enumerated the device, 0 while unplugged
+uint64_t usb_network_up_us();
 void usb_network_update();
+// the two halves of usb_network_update(), for timing them separately
+void usb_network_update_usb();
+void usb_network_update_lwip();
 void usb_network_deinit();
 
 #ifdef __cplusplus